@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../memory_accountant.h"
+
+// FNV-1a over token ids. Shared by the Bloom pass and seed gathering so that
+// both agree on which counter an n-gram maps to.
+inline uint64_t hash_tokens(const uint32_t* tokens, int n) {
+    uint64_t h = 14695981039346656037ULL; // FNV offset basis
+    for (int i = 0; i < n; ++i) {
+        h ^= static_cast<uint64_t>(tokens[i]);
+        h *= 1099511628211ULL; // FNV prime
+    }
+    return h;
+}
+
+// Number of n-gram windows in the corpus, i.e. the number of add() calls
+// a full Bloom pass will make.
+inline size_t count_ngram_windows(const std::vector<uint32_t>& doc_lengths, int ngrams) {
+    size_t total = 0;
+    for (uint32_t len : doc_lengths)
+        if (len >= (uint32_t)ngrams) total += len - ngrams + 1;
+    return total;
+}
+
+// Single-hash counting Bloom filter with saturating 8-bit counters.
+// add() is safe to call from several threads at once.
+class CountingBloomFilter {
+public:
+    static constexpr size_t MIN_SIZE = 1ULL << 20;           // 1 MB
+    static constexpr size_t MAX_SIZE = 2048ULL * 1024 * 1024; // 2 GB
+    static constexpr size_t HISTOGRAM_BUCKETS = 10;          // 0, 1, 2-3, ..., 128-254, 255
+
+    struct Stats {
+        std::array<size_t, HISTOGRAM_BUCKETS> histogram{};
+        size_t nonzero = 0;
+        size_t above_threshold = 0;  // counters >= threshold
+        size_t surviving_windows = 0; // windows counted in them (saturated ones as 255)
+        double occupancy = 0.0;      // nonzero / size
+        double load = 0.0;           // n-gram windows per counter
+        double estimated_fp = 0.0;   // share of singletons the filter lets through
+    };
+
+    explicit CountingBloomFilter(size_t size_bytes)
+        : reservation(MemComponent::BloomFilter, size_bytes), counters(size_bytes, 0) {}
+
+    size_t size() const { return counters.size(); }
+    size_t memory_bytes() const { return counters.capacity(); }
+
+    void add(uint64_t h) {
+        uint8_t* target = &counters[h % counters.size()];
+        uint8_t current = __atomic_load_n(target, __ATOMIC_RELAXED);
+        while (current < 255) {
+            if (__atomic_compare_exchange_n(target, &current, current + 1, false,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+    }
+
+    uint8_t count(uint64_t h) const { return counters[h % counters.size()]; }
+
+    void release() {
+        counters.clear();
+        counters.shrink_to_fit();
+        reservation.resize(0);
+    }
+
+    // Probability that an n-gram seen once reaches `threshold` purely through
+    // collisions, when each counter receives Poisson(load) foreign windows.
+    static double singleton_fp_rate(double load, int threshold) {
+        int needed = threshold - 1;
+        if (needed <= 0) return 1.0;
+        double term = std::exp(-load);
+        double below = 0.0;
+        for (int k = 0; k < needed; ++k) {
+            below += term;
+            term *= load / (k + 1);
+        }
+        return std::max(0.0, 1.0 - below);
+    }
+
+    // Smallest filter whose modelled singleton FP rate stays at or below
+    // target_fp for `total_ngrams` windows. Clamped to [MIN_SIZE, MAX_SIZE].
+    static size_t auto_size(size_t total_ngrams, int threshold, double target_fp) {
+        if (threshold <= 1 || total_ngrams == 0) return MIN_SIZE;
+        // Bisect on the load; singleton_fp_rate is increasing in it.
+        double lo = 0.0, hi = (double)threshold;
+        for (int it = 0; it < 60; ++it) {
+            double mid = 0.5 * (lo + hi);
+            if (singleton_fp_rate(mid, threshold) <= target_fp) lo = mid;
+            else hi = mid;
+        }
+        double wanted = lo > 0.0 ? std::ceil((double)total_ngrams / lo) : (double)MAX_SIZE;
+        if (wanted < (double)MIN_SIZE) return MIN_SIZE;
+        if (wanted > (double)MAX_SIZE) return MAX_SIZE;
+        return (size_t)wanted;
+    }
+
+    // Counter histogram and saturation after a pass over `total_ngrams` windows.
+    // The FP estimate is empirical: a singleton is accepted when the rest of its
+    // counter already holds threshold - 1, so it is the share of such counters.
+    Stats stats(int threshold, size_t total_ngrams) const {
+        Stats s;
+        size_t near_threshold = 0;
+        const size_t m = counters.size();
+        const int threshold_u8 = std::min(threshold, 255);
+        const int near_u8 = std::max(threshold_u8 - 1, 0);
+
+        #pragma omp parallel
+        {
+            std::array<size_t, HISTOGRAM_BUCKETS> local{};
+            size_t local_nonzero = 0, local_above = 0, local_near = 0, local_surviving = 0;
+
+            #pragma omp for nowait
+            for (size_t i = 0; i < m; ++i) {
+                uint8_t v = counters[i];
+                local[bucket_of(v)]++;
+                local_nonzero += (v != 0);
+                local_above += (v >= threshold_u8);
+                local_surviving += (v >= threshold_u8) ? v : 0;
+                local_near += (v >= near_u8);
+            }
+
+            #pragma omp critical
+            {
+                for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) s.histogram[b] += local[b];
+                s.nonzero += local_nonzero;
+                s.above_threshold += local_above;
+                s.surviving_windows += local_surviving;
+                near_threshold += local_near;
+            }
+        }
+
+        if (m > 0) {
+            s.occupancy = (double)s.nonzero / m;
+            s.load = (double)total_ngrams / m;
+            s.estimated_fp = (threshold <= 1) ? 1.0 : (double)near_threshold / m;
+        }
+        return s;
+    }
+
+    // Filter size for a run: --bloom-mb if given, otherwise auto_size() capped
+    // at 20% of the memory limit and at what is left of it after the other
+    // reservations. `capped_by_mem` reports whether a cap bit.
+    static size_t choose_size(size_t total_ngrams, int threshold, double target_fp,
+                              size_t bloom_mb, size_t memory_limit_mb, bool& capped_by_mem) {
+        capped_by_mem = false;
+        if (bloom_mb > 0) return bloom_mb * 1024ULL * 1024ULL;
+        size_t size = auto_size(total_ngrams, threshold, target_fp);
+        if (memory_limit_mb > 0) {
+            size_t mem_cap = std::min<size_t>((memory_limit_mb * 1024ULL * 1024ULL) / 5,
+                                              memory_accountant().available());
+            if (size > mem_cap) {
+                size = std::max(mem_cap, MIN_SIZE);
+                capped_by_mem = true;
+            }
+        }
+        return size;
+    }
+
+    static const char* bucket_label(size_t b) {
+        static const char* labels[HISTOGRAM_BUCKETS] = {
+            "0", "1", "2-3", "4-7", "8-15", "16-31", "32-63", "64-127", "128-254", "255"};
+        return labels[b];
+    }
+
+private:
+    MemoryReservation reservation;
+    std::vector<uint8_t> counters;
+
+    static size_t bucket_of(uint8_t v) {
+        if (v == 0) return 0;
+        if (v == 255) return HISTOGRAM_BUCKETS - 1;
+        size_t b = 1;
+        while (v > 1) { v >>= 1; ++b; }
+        return b;
+    }
+};
@@ -1,249 +1,123 @@
 #include "bloom_gram_miner.h"
+#include "bloom_filter.h"
+#include "candidate_file.h"
+#include "candidate_store.h"
+#include "coverage_bitmap.h"
+#include "frequent_runs.h"
+#include "seed_record.h"
+#include "seed_sort.h"
+#include "seed_runs.h"
+#include "io_error.h"
+#include "seed_length.h"
+#include "seed_table.h"
+#include "space_saving.h"
+#include "support_counter.h"
+#include "token_span.h"
 #include "../timer.h"
 #include "../signal_handler.h"
+#include "../memory_accountant.h"
 #include <filesystem>
 #include <iostream>
 #include <fstream>
 #include <execution>
-#include <queue>
 #include <random>
 #include <omp.h>
-#include <unordered_set>
 #include <unordered_map>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <iterator>
 #include <cstring>
-#include <vector>
 #include <unistd.h>
-#ifdef __APPLE__
-#include <mach/mach.h>
-#endif
+#include <vector>
 
 namespace fs = std::filesystem;
 
-// Local copy of constants/structs/helpers used by the Bloom n-gram miner.
-// These mirror the definitions in corpus_miner.cpp, but are TU-local here.
-const int SMALL_NGRAMS_THRESHOLD = 16;  // Use fixed array for n <= this value
-const int MAX_NGRAMS_FIXED = 16;        // Maximum size for fixed array
 const int DEBUG = 0;                    // to see internal structures in the console
 
-struct RawSeedEntry {
-    uint32_t doc_id;
-    uint32_t pos;
-    int n;
-
-    // Hybrid storage: fixed array for small n-grams, vector for large ones
-    union {
-        uint32_t fixed_tokens[MAX_NGRAMS_FIXED];
-        std::vector<uint32_t>* dynamic_tokens;
-    } tokens;
-
-    // Flag to indicate which storage is being used
-    bool is_dynamic;
-
-    RawSeedEntry() : doc_id(0), pos(0), n(0), is_dynamic(false) {
-        std::memset(tokens.fixed_tokens, 0, sizeof(tokens.fixed_tokens));
-    }
-
-    ~RawSeedEntry() {
-        if (is_dynamic && tokens.dynamic_tokens != nullptr) {
-            delete tokens.dynamic_tokens;
-            tokens.dynamic_tokens = nullptr;
-        }
-    }
-
-    // Copy constructor
-    RawSeedEntry(const RawSeedEntry& other)
-        : doc_id(other.doc_id),
-          pos(other.pos),
-          n(other.n),
-          is_dynamic(other.is_dynamic) {
-        if (is_dynamic) {
-            tokens.dynamic_tokens = new std::vector<uint32_t>(*other.tokens.dynamic_tokens);
-        } else {
-            std::memcpy(tokens.fixed_tokens, other.tokens.fixed_tokens,
-                        sizeof(tokens.fixed_tokens));
-        }
-    }
-
-    // Move constructor
-    RawSeedEntry(RawSeedEntry&& other) noexcept
-        : doc_id(other.doc_id),
-          pos(other.pos),
-          n(other.n),
-          is_dynamic(other.is_dynamic) {
-        if (is_dynamic) {
-            tokens.dynamic_tokens = other.tokens.dynamic_tokens;
-            other.tokens.dynamic_tokens = nullptr;
-        } else {
-            std::memcpy(tokens.fixed_tokens, other.tokens.fixed_tokens,
-                        sizeof(tokens.fixed_tokens));
-        }
-    }
-
-    // Copy assignment
-    RawSeedEntry& operator=(const RawSeedEntry& other) {
-        if (this == &other) return *this;
-
-        // Clean up old data
-        if (is_dynamic && tokens.dynamic_tokens != nullptr) {
-            delete tokens.dynamic_tokens;
-            tokens.dynamic_tokens = nullptr;
-        }
-
-        doc_id = other.doc_id;
-        pos = other.pos;
-        n = other.n;
-        is_dynamic = other.is_dynamic;
-
-        if (is_dynamic) {
-            tokens.dynamic_tokens = new std::vector<uint32_t>(*other.tokens.dynamic_tokens);
-        } else {
-            std::memcpy(tokens.fixed_tokens, other.tokens.fixed_tokens,
-                        sizeof(tokens.fixed_tokens));
-        }
-        return *this;
-    }
-
-    // Move assignment
-    RawSeedEntry& operator=(RawSeedEntry&& other) noexcept {
-        if (this == &other) return *this;
-
-        // Clean up old data
-        if (is_dynamic && tokens.dynamic_tokens != nullptr) {
-            delete tokens.dynamic_tokens;
-            tokens.dynamic_tokens = nullptr;
-        }
-
-        doc_id = other.doc_id;
-        pos = other.pos;
-        n = other.n;
-        is_dynamic = other.is_dynamic;
-
-        if (is_dynamic) {
-            tokens.dynamic_tokens = other.tokens.dynamic_tokens;
-            other.tokens.dynamic_tokens = nullptr;
-        } else {
-            std::memcpy(tokens.fixed_tokens, other.tokens.fixed_tokens,
-                        sizeof(tokens.fixed_tokens));
-        }
-        return *this;
-    }
-
-    // Helper to get token at index
-    uint32_t get_token(int idx) const {
-        if (is_dynamic) {
-            return (*tokens.dynamic_tokens)[idx];
-        } else {
-            return tokens.fixed_tokens[idx];
-        }
-    }
-
-    // Helper to set token at index
-    void set_token(int idx, uint32_t value) {
-        if (is_dynamic) {
-            (*tokens.dynamic_tokens)[idx] = value;
-        } else {
-            tokens.fixed_tokens[idx] = value;
-        }
-    }
-
-    // Initialize with n-grams
-    void init_tokens(int num_tokens) {
-        if (is_dynamic && tokens.dynamic_tokens != nullptr) {
-            delete tokens.dynamic_tokens;
-            tokens.dynamic_tokens = nullptr;
-        }
-
-        n = num_tokens;
-        if (num_tokens > SMALL_NGRAMS_THRESHOLD) {
-            is_dynamic = true;
-            tokens.dynamic_tokens = new std::vector<uint32_t>(num_tokens, 0);
-        } else {
-            is_dynamic = false;
-            std::memset(tokens.fixed_tokens, 0, sizeof(tokens.fixed_tokens));
-        }
-    }
-
-    // Оператор для priority_queue (нужен обратный порядок для min-heap)
-    bool operator>(const RawSeedEntry& other) const {
-        for (int i = 0; i < n; ++i) {
-            uint32_t this_token =
-                (is_dynamic) ? (*tokens.dynamic_tokens)[i] : tokens.fixed_tokens[i];
-            uint32_t other_token = (other.is_dynamic)
-                                       ? (*other.tokens.dynamic_tokens)[i]
-                                       : other.tokens.fixed_tokens[i];
-            if (this_token != other_token) return this_token > other_token;
-        }
-        if (doc_id != other.doc_id) return doc_id > other.doc_id;
-        return pos > other.pos;
-    }
+// Step 1 seed buffer budget under --mem: 75% of what is left (the rest is
+// headroom for untracked allocations), at least one run block per thread,
+// but never more than is left; the spill path handles the rest. Never 0,
+// which would mean "never spill".
+static size_t seed_budget(int num_threads) {
+    const size_t available = memory_accountant().available();
+    const size_t min_budget = (size_t)num_threads * SEED_RUN_BLOCK_RECORDS * sizeof(SeedRecord);
+    return std::max<size_t>(std::min(available, std::max(available / 4 * 3, min_budget)), 1);
+}
 
-    bool same_tokens(const RawSeedEntry& other) const {
-        for (int i = 0; i < n; ++i) {
-            uint32_t this_token =
-                (is_dynamic) ? (*tokens.dynamic_tokens)[i] : tokens.fixed_tokens[i];
-            uint32_t other_token = (other.is_dynamic)
-                                       ? (*other.tokens.dynamic_tokens)[i]
-                                       : other.tokens.fixed_tokens[i];
-            if (this_token != other_token) return false;
-        }
-        return true;
+// --ngrams auto: the smallest seed length whose projected Step 1 seeds fit
+// in 75% of what --mem has left (half the physical memory without --mem).
+// In memory the radix sort needs a second array, so a seed costs twice.
+static int auto_seed_length(const CorpusMiner& corpus, const MiningParams& params) {
+    constexpr int MIN_NGRAMS = 2, MAX_NGRAMS = 12;
+    auto start = start_timer();
+    if (corpus.get_max_threads() > 0) omp_set_num_threads(corpus.get_max_threads());
+    size_t budget = memory_accountant().has_limit()
+                        ? seed_budget(omp_get_max_threads())
+                        : (size_t)sysconf(_SC_PHYS_PAGES) * (size_t)sysconf(_SC_PAGE_SIZE) / 2;
+    size_t bytes_per_seed = sizeof(SeedRecord) * (corpus.is_in_memory_only() ? 2 : 1);
+
+    SeedLengthChoice choice = choose_seed_length(corpus, params.min_docs, params.auto_sample, budget,
+                                                 bytes_per_seed, MIN_NGRAMS, MAX_NGRAMS);
+    std::cout << "[LOG] Seed length: sampled " << (100.0 * choice.fraction) << "% of documents, budget "
+              << (budget / (1024 * 1024)) << " MB" << std::endl;
+    for (const auto& e : choice.estimates) {
+        std::cout << "[LOG]   n=" << e.ngrams << ": " << e.sample_seeds << " of " << e.sample_windows
+                  << " sampled windows survive -> ~" << e.projected_seeds << " seeds ("
+                  << (e.projected_bytes / (1024 * 1024)) << " MB)" << std::endl;
     }
+    if (choice.fits)
+        std::cout << "[LOG] Seed length: --ngrams " << choice.ngrams << " is the smallest that fits" << std::endl;
+    else
+        std::cout << "[WARNING] Seed length: no n up to " << MAX_NGRAMS << " fits the budget; using "
+                  << choice.ngrams << std::endl;
+    stop_timer("Seed Length Selection", start);
+    return choice.ngrams;
+}
 
-    // Serialization: writes to binary stream
-    void write_to_stream(std::ofstream& out) const {
-        out.write((char*)&doc_id, sizeof(doc_id));
-        out.write((char*)&pos, sizeof(pos));
-        out.write((char*)&n, sizeof(n));
-        out.write((char*)&is_dynamic, sizeof(is_dynamic));
-
-        if (is_dynamic) {
-            for (int i = 0; i < n; ++i) {
-                uint32_t token = (*tokens.dynamic_tokens)[i];
-                out.write((char*)&token, sizeof(token));
-            }
-        } else {
-            out.write((char*)tokens.fixed_tokens, n * sizeof(uint32_t));
-        }
-    }
-
-    // Deserialization: reads from binary stream
-    void read_from_stream(std::ifstream& in) {
-        in.read((char*)&doc_id, sizeof(doc_id));
-        in.read((char*)&pos, sizeof(pos));
-        in.read((char*)&n, sizeof(n));
-        in.read((char*)&is_dynamic, sizeof(is_dynamic));
-
-        if (is_dynamic && tokens.dynamic_tokens != nullptr) {
-            delete tokens.dynamic_tokens;
-            tokens.dynamic_tokens = nullptr;
-        }
+// Heap bytes behind a phrase, reserved under MemComponent::Expansion while
+// Step 3 holds it (the Phrase itself is counted by its vector's capacity).
+static size_t phrase_bytes(const Phrase& p) {
+    return p.tokens.capacity() * sizeof(uint32_t) + p.occs.capacity() * sizeof(Occurrence);
+}
 
-        if (is_dynamic) {
-            tokens.dynamic_tokens = new std::vector<uint32_t>(n);
-            for (int i = 0; i < n; ++i) {
-                uint32_t token;
-                in.read((char*)&token, sizeof(token));
-                (*tokens.dynamic_tokens)[i] = token;
-            }
-        } else {
-            std::memset(tokens.fixed_tokens, 0, sizeof(tokens.fixed_tokens));
-            in.read((char*)tokens.fixed_tokens, n * sizeof(uint32_t));
-        }
+// Seed-length cascade: passes run from the longest seed length down, all
+// marking one coverage bitmap, so long boilerplate is found by cheap
+// long-seed passes and the short-seed pass only sees the residual text.
+std::vector<Phrase> BloomNgramMiner::mine(const CorpusMiner& corpus,
+                                          const MiningParams& params) {
+    if (params.ngrams <= 0 && params.ngram_cascade.empty()) {
+        MiningParams chosen = params;
+        chosen.ngrams = auto_seed_length(corpus, params);
+        if (chosen.min_l == 0) chosen.min_l = chosen.ngrams;
+        return mine_pass(corpus, chosen, nullptr);
     }
-};
-
-inline uint64_t hash_tokens(const uint32_t* tokens, int n) {
-    uint64_t h = 14695981039346656037ULL; // FNV offset basis
-    for (int i = 0; i < n; ++i) {
-        h ^= static_cast<uint64_t>(tokens[i]);
-        h *= 1099511628211ULL; // FNV prime
+    if (params.ngram_cascade.empty()) return mine_pass(corpus, params, nullptr);
+
+    auto cascade_start = start_timer();
+    CoverageBitmap covered(corpus.get_doc_lengths());
+    MemoryReservation covered_reservation(MemComponent::Expansion, covered.memory_bytes());
+    std::vector<Phrase> phrases;
+    size_t phrase_heap_bytes = 0;
+    MemoryReservation phrase_reservation(MemComponent::Expansion);
+    MiningParams pass = params;
+    for (size_t i = 0; i < params.ngram_cascade.size() && !g_stop_requested; ++i) {
+        pass.ngrams = params.ngram_cascade[i];
+        std::cout << "[LOG] Cascade pass " << (i + 1) << "/" << params.ngram_cascade.size() << ": "
+                  << pass.ngrams << "-gram seeds over uncovered text" << std::endl;
+        std::vector<Phrase> found = mine_pass(corpus, pass, &covered);
+        std::cout << "[LOG] Cascade pass " << (i + 1) << ": " << found.size() << " phrases" << std::endl;
+        for (const Phrase& p : found) phrase_heap_bytes += phrase_bytes(p);
+        std::move(found.begin(), found.end(), std::back_inserter(phrases));
+        phrase_reservation.resize(phrase_heap_bytes + phrases.capacity() * sizeof(Phrase));
     }
-    return h;
+    std::cout << "[LOG] Cascade: " << phrases.size() << " phrases in total" << std::endl;
+    stop_timer("Seed-Length Cascade", cascade_start);
+    return phrases;
 }
 
-std::vector<Phrase> BloomNgramMiner::mine(const CorpusMiner& corpus,
-                                          const MiningParams& params) {
+std::vector<Phrase> BloomNgramMiner::mine_pass(const CorpusMiner& corpus, const MiningParams& params,
+                                               CoverageBitmap* covered) {
     // Unpack params
     int min_docs = params.min_docs;
     int ngrams   = params.ngrams;
@@ -259,81 +133,185 @@ std::vector<Phrase> BloomNgramMiner::mine(const CorpusMiner& corpus,
     const auto& id_to_word     = corpus.get_id_to_word();
     const auto& bin_corpus_path = corpus.get_bin_corpus_path();
 
-    // Local helper to get current RSS (copy of original CorpusMiner::get_current_rss_mb)
-    auto get_current_rss_mb = []() -> size_t {
-#ifdef __APPLE__
-        struct mach_task_basic_info info;
-        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
-        if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) == KERN_SUCCESS) {
-            return info.resident_size / (1024 * 1024);
-        }
-        return 0;
-#else
-        std::ifstream stat_stream("/proc/self/statm", std::ios_base::in);
-        unsigned long long pages;
-        if (!(stat_stream >> pages >> pages)) return 0;
-        return (pages * sysconf(_SC_PAGESIZE)) / (1024 * 1024);
-#endif
-    };
-
     if (max_threads > 0) {
         omp_set_num_threads(max_threads);
         std::cout << "[LOG] Threads limited to: " << max_threads << std::endl;
     }
 
-    // 1. Dynamic Filter Size: Aim for ~20% of memory limit, capped at 2GB.
-    // A larger filter significantly reduces collisions for bigrams.
-    size_t filter_size;
-    if (memory_limit_mb > 0) {
-        filter_size = (memory_limit_mb * 1024ULL * 1024ULL) / 5; // 20% of limit
-        if (filter_size > 2048ULL * 1024ULL * 1024ULL) filter_size = 2048ULL * 1024ULL * 1024ULL;
-    } else {
-        filter_size = 512ULL * 1024ULL * 1024ULL;
+    // 1. Filter size: derived from the number of n-gram windows (known from
+    // doc_lengths) and the target FP rate, unless --bloom-mb pins it.
+    const int bloom_threshold = std::min(min_docs, 255);
+    const size_t total_windows = count_ngram_windows(doc_lengths, ngrams);
+
+    // --seed-mode topk replaces the filter with Space-Saving summaries: only
+    // the top_k n-grams by estimated document frequency become seeds.
+    const bool topk = params.seed_mode == "topk";
+
+    // With --fused-bloom the loader already counted every window while encoding.
+    std::unique_ptr<CountingBloomFilter> filter_ptr;
+    if (ngrams == sketch_ngrams) filter_ptr = std::move(ngram_sketch);
+    if (topk && filter_ptr) {
+        std::cout << "[LOG] --seed-mode topk does not use the loader's Bloom sketch" << std::endl;
+        filter_ptr.reset();
     }
-
-    std::cout << "[LOG] Initializing Bloom Filter: " << (filter_size / (1024 * 1024)) << " MB" << std::endl;
-    std::vector<uint8_t> filter_counters(filter_size, 0);
+    const bool fused = (filter_ptr != nullptr);
+    bool capped_by_mem = false;
+    if (fused) {
+        capped_by_mem = sketch_capped;
+        std::cout << "[LOG] Bloom Pass: using the " << (filter_ptr->size() / (1024 * 1024))
+                  << " MB sketch built during corpus loading" << std::endl;
+    } else if (!topk) {
+        size_t filter_size = CountingBloomFilter::choose_size(total_windows, bloom_threshold, params.bloom_fp,
+                                                              params.bloom_mb, memory_limit_mb, capped_by_mem);
+        std::cout << "[LOG] Initializing Bloom Filter: " << (filter_size / (1024 * 1024)) << " MB for "
+                  << total_windows << " n-gram windows (target FP " << params.bloom_fp << ")"
+                  << (capped_by_mem ? " [capped by --mem]" : "") << std::endl;
+        filter_ptr = std::make_unique<CountingBloomFilter>(filter_size);
+    }
+    CountingBloomFilter* filter = filter_ptr.get();
+
+    // Rare-token break index: a window that covers a token with
+    // word_df < min_docs can never be frequent, so both passes below only
+    // visit windows inside maximal runs of frequent tokens. The Bloom pass
+    // records the runs; Step 1 reuses them (or scans them itself when the
+    // loader built the sketch).
+    FrequentRunIndex run_index(word_df, min_docs, ngrams);
+    MemoryReservation run_index_reservation(MemComponent::RunIndex);
+    size_t windows_counted = total_windows;
+
+    // Space-Saving state: one summary per thread, each counting every n-gram
+    // once per document; merged, the top_k keys whose count can still reach
+    // min_docs are the ones Step 1 gathers.
+    const size_t summary_capacity = std::max<size_t>(16 * params.top_k, 65536);
+    std::vector<SpaceSavingSummary> summaries;
+    std::vector<uint64_t> heavy_keys; // sorted
+    if (topk) {
+        summaries.reserve(omp_get_max_threads());
+        for (int t = 0; t < omp_get_max_threads(); ++t) summaries.emplace_back(summary_capacity);
+    }
+    MemoryReservation summary_reservation(MemComponent::BloomFilter,
+                                          summaries.size() * SpaceSavingSummary::bytes_for(summary_capacity));
 
     // Pass 1: Frequency Estimation
-    std::cout << "[LOG] Bloom Pass: Estimating n-gram frequencies..." << std::endl;
-    #pragma omp parallel
-    {
-        std::ifstream local_bin;
-        if (!in_memory_only) local_bin.open(bin_corpus_path, std::ios::binary);
+    if (!fused) {
+        if (topk)
+            std::cout << "[LOG] Space-Saving Pass: Summarizing n-gram document frequencies ("
+                      << summary_capacity << " keys per thread)..." << std::endl;
+        else
+            std::cout << "[LOG] Bloom Pass: Estimating n-gram frequencies..." << std::endl;
+        std::vector<std::vector<FrequentRunIndex::DocRun>> recorded_runs(omp_get_max_threads());
+        windows_counted = 0;
+
+        #pragma omp parallel reduction(+ : windows_counted)
+        {
+            auto& my_runs = recorded_runs[omp_get_thread_num()];
+            std::vector<uint8_t> flags;
+            std::vector<TokenRun> runs;
+            std::vector<uint64_t> doc_hashes;
+            std::ifstream local_bin;
+            if (!in_memory_only) local_bin.open(bin_corpus_path, std::ios::binary);
+
+            #pragma omp for
+            for (uint32_t d = 0; d < (uint32_t)doc_lengths.size(); ++d) {
+                std::vector<uint32_t> local_doc;
+                const std::vector<uint32_t>* doc_ptr = nullptr;
+
+                if (in_memory_only) {
+                    // In-memory mode: fetch directly from corpus
+                    doc_ptr = &corpus.get_doc(d);
+                } else {
+                    // Disk mode: load from BIN file
+                    local_doc.resize(doc_lengths[d]);
+                    local_bin.seekg(doc_offsets[d]);
+                    local_bin.read((char*)local_doc.data(), doc_lengths[d] * sizeof(uint32_t));
+                    doc_ptr = &local_doc;
+                }
 
-        #pragma omp for
-        for (uint32_t d = 0; d < (uint32_t)doc_lengths.size(); ++d) {
-            std::vector<uint32_t> local_doc;
-            const std::vector<uint32_t>* doc_ptr = nullptr;
+                if (doc_ptr->size() < (size_t)ngrams) continue;
 
-            if (in_memory_only) {
-                // In-memory mode: fetch directly from corpus
-                doc_ptr = &corpus.get_doc(d);
-            } else {
-                // Disk mode: load from BIN file
-                local_doc.resize(doc_lengths[d]);
-                local_bin.seekg(doc_offsets[d]);
-                local_bin.read((char*)local_doc.data(), doc_lengths[d] * sizeof(uint32_t));
-                doc_ptr = &local_doc;
-            }
-
-            if (doc_ptr->size() < (size_t)ngrams) continue;
+                runs.clear();
+                run_index.scan(doc_ptr->data(), doc_ptr->size(), flags, runs);
 
-            // here we count the ngrams before the counter reaches 255
-            // the goal is to filter out the ngrams with low frequency (<num_docs) from further processing
-            for (uint32_t p = 0; p <= doc_ptr->size() - ngrams; ++p) {
-                uint64_t h = hash_tokens(doc_ptr->data() + p, ngrams);
-                size_t idx = h % filter_size;
+                // here we count the ngrams before the counter reaches 255
+                // the goal is to filter out the ngrams with low frequency (<num_docs) from further processing
+                for (const auto& r : runs) {
+                    my_runs.push_back({d, r});
+                    for (uint32_t p = r.start; p + ngrams <= r.start + r.length; ++p) {
+                        if (covered && covered->test(covered->position(d, p))) continue;
+                        uint64_t h = hash_tokens(doc_ptr->data() + p, ngrams);
+                        if (filter) filter->add(h);
+                        else doc_hashes.push_back(h);
+                    }
+                    windows_counted += r.length - ngrams + 1;
+                }
 
-                uint8_t* target = &filter_counters[idx];
-                uint8_t current = __atomic_load_n(target, __ATOMIC_RELAXED);
-                while (current < 255) {
-                    if (__atomic_compare_exchange_n(target, &current, current + 1, false,
-                                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
-                        break;
+                // Space-Saving counts documents: each distinct n-gram once.
+                if (topk) {
+                    std::sort(doc_hashes.begin(), doc_hashes.end());
+                    auto& summary = summaries[omp_get_thread_num()];
+                    for (size_t i = 0; i < doc_hashes.size(); ++i)
+                        if (i == 0 || doc_hashes[i] != doc_hashes[i - 1]) summary.offer(doc_hashes[i]);
+                    doc_hashes.clear();
                 }
             }
         }
+        run_index.build(recorded_runs, doc_lengths.size());
+        run_index_reservation.resize(run_index.memory_bytes());
+
+        size_t skipped = total_windows - windows_counted;
+        std::cout << "[LOG] Rare-token index: " << skipped << " of " << total_windows << " windows ("
+                  << (total_windows ? 100.0 * skipped / total_windows : 0.0)
+                  << "%) contain a token below min_docs and are skipped" << std::endl;
+    }
+
+    if (topk) {
+        SpaceSavingSummary& merged = summaries[0];
+        for (size_t t = 1; t < summaries.size(); ++t) merged.merge(summaries[t]);
+        size_t guaranteed = 0;
+        uint32_t max_error = 0, lowest = 0;
+        for (const auto& e : merged.top(params.top_k)) {
+            if (e.count < (uint32_t)min_docs) break;
+            heavy_keys.push_back(e.key);
+            max_error = std::max(max_error, e.error);
+            lowest = e.count;
+            if (e.count - e.error >= (uint32_t)min_docs) guaranteed++;
+        }
+        std::sort(heavy_keys.begin(), heavy_keys.end());
+        std::cout << "[LOG] Space-Saving: " << merged.offered() << " (document, n-gram) pairs; top "
+                  << heavy_keys.size() << " keys (down to " << lowest << " documents) may reach min_docs ("
+                  << guaranteed << " guaranteed), document counts overestimated by at most " << max_error
+                  << " (bound " << merged.offered() / merged.capacity() << ")" << std::endl;
+        summaries.clear();
+        summaries.shrink_to_fit();
+        summary_reservation.resize(heavy_keys.size() * sizeof(uint64_t));
+    }
+
+    // Saturation report: tells whether the filter (or --mem capping it) is
+    // what lets rare n-grams through to Step 1.
+    CountingBloomFilter::Stats fs_stats;
+    if (filter) {
+        fs_stats = filter->stats(bloom_threshold, windows_counted);
+        std::cout << "[BLOOM STATS] Counter histogram:";
+        for (size_t b = 0; b < CountingBloomFilter::HISTOGRAM_BUCKETS; ++b) {
+            if (fs_stats.histogram[b] == 0) continue;
+            std::cout << " [" << CountingBloomFilter::bucket_label(b) << "]="
+                      << (100.0 * fs_stats.histogram[b] / filter->size()) << "%";
+        }
+        std::cout << std::endl;
+        std::cout << "[BLOOM STATS] Occupancy:   " << (100.0 * fs_stats.occupancy) << "% ("
+                  << fs_stats.load << " windows/counter, "
+                  << (100.0 * fs_stats.above_threshold / filter->size()) << "% >= " << bloom_threshold << ")"
+                  << std::endl;
+        std::cout << "[BLOOM STATS] Est. FP:     " << (100.0 * fs_stats.estimated_fp) << "% (target "
+                  << (100.0 * params.bloom_fp) << "%)" << std::endl;
+        // The Poisson sizing model ignores heavy hitters, so allow some slack
+        // before blaming the filter.
+        if (bloom_threshold > 1 && fs_stats.estimated_fp > 1.5 * params.bloom_fp) {
+            std::cout << "[BLOOM STATS] Filter is saturated: "
+                      << (capped_by_mem ? "--mem is the bottleneck (the filter was capped by it)"
+                                        : "the filter is the bottleneck, raise --bloom-mb")
+                      << std::endl;
+        }
     }
 
     // we collected the ngram stats in filter counters
@@ -350,99 +328,283 @@ std::vector<Phrase> BloomNgramMiner::mine(const CorpusMiner& corpus,
     std::string temp_dir = "./miner_tmp";
     fs::create_directories(temp_dir);
     std::vector<std::string> chunk_files;
-    std::vector<RawSeedEntry> buffer;
-    buffer.reserve(1000000);
-    int chunk_id = 0;
+    std::mutex chunk_mtx;
+    std::atomic<int> chunk_id{0};
+    std::atomic<size_t> spilled_records{0};
+    std::atomic<size_t> spilled_bytes{0};
+
+    // Seeds are gathered into per-thread buffers whose bytes are reserved
+    // with the memory accountant. The threads share one seed_budget() of what
+    // --mem has left after the corpus, the Bloom filter and the run index.
+    // A thread whose buffer holds its share of the budget sorts it and
+    // spills it as an independent run once the shared total is exhausted, or
+    // once --mem itself is.
+    const int num_threads = omp_get_max_threads();
+    size_t seed_budget_bytes = 0; // 0 = never spill before the end
+    if (memory_accountant().has_limit() && !in_memory_only) {
+        seed_budget_bytes = seed_budget(num_threads);
+        std::cout << "[LOG] Seed buffer budget: " << (seed_budget_bytes / 1024)
+                  << " KB across " << num_threads << " threads" << std::endl;
+    }
+    // --seed-mode partition: spills go to P hash-range partitions instead of
+    // sorted runs. P is chosen so that each thread can hold one partition
+    // (plus sort scratch) within the seed budget, assuming every counted
+    // window survives the filter.
+    std::unique_ptr<SeedPartitionWriter> partitions;
+    if (params.seed_mode == "partition" && !in_memory_only) {
+        size_t num_partitions = params.seed_partitions;
+        if (num_partitions == 0) {
+            size_t budget = seed_budget_bytes ? seed_budget_bytes : (size_t)num_threads * 128 * 1024 * 1024;
+            size_t per_partition = std::max<size_t>(budget / (2 * num_threads), 1);
+            size_t estimate = windows_counted * sizeof(SeedRecord);
+            num_partitions = std::clamp<size_t>((estimate + per_partition - 1) / per_partition,
+                                                4 * num_threads, 512);
+        }
+        partitions = std::make_unique<SeedPartitionWriter>(temp_dir, num_partitions);
+        std::cout << "[LOG] Seed spills: " << partitions->partitions() << " hash partitions" << std::endl;
+    } else if (params.seed_mode == "partition") {
+        std::cout << "[LOG] --seed-mode partition only applies without --in-mem; sorting in RAM" << std::endl;
+    }
 
-    auto flush_buffer = [&]() {
+    // --seed-mode hash: count distinct documents per key in a concurrent
+    // table instead of sorting every occurrence. Expected keys are the
+    // counters at or above the threshold plus the foreign windows that
+    // collided into them; the occurrences are roughly the windows those
+    // counters saw. In memory the radix sort is faster, so "auto" only picks
+    // the table when the sorted seeds would spill but the table fits the
+    // seed budget. If the table or the occurrence budget overflows anyway,
+    // gathered occurrences turn back into seeds and Step 1 carries on in
+    // sort mode.
+    std::unique_ptr<SeedHashTable> table;
+    std::vector<std::vector<SeedHashTable::Occurrence>> thread_occs(num_threads);
+    size_t occ_budget_bytes = 0; // 0 = unlimited
+    std::atomic<size_t> occ_bytes{0};
+    std::atomic<bool> table_overflow{false};
+    if (params.seed_mode == "hash" || params.seed_mode == "auto") {
+        size_t expected_keys = (size_t)(fs_stats.above_threshold * (1.0 + fs_stats.load));
+        size_t table_bytes = SeedHashTable::bytes_for(expected_keys);
+        size_t estimate = table_bytes + fs_stats.surviving_windows * sizeof(SeedHashTable::Occurrence);
+        bool sort_spills = seed_budget_bytes > 0 && fs_stats.surviving_windows * sizeof(SeedRecord) > seed_budget_bytes;
+        bool table_fits = seed_budget_bytes == 0 || estimate <= seed_budget_bytes;
+        if (params.seed_mode == "hash" || (sort_spills && table_fits)) {
+            table = std::make_unique<SeedHashTable>(expected_keys);
+            if (seed_budget_bytes > 0)
+                occ_budget_bytes = std::max<size_t>(seed_budget_bytes, table_bytes + 1) - table_bytes;
+            std::cout << "[LOG] Seed table: " << table->capacity() << " slots ("
+                      << (table_bytes / (1024 * 1024)) << " MB) for ~" << expected_keys << " keys" << std::endl;
+        } else if (sort_spills) {
+            std::cout << "[LOG] Seed table estimate (" << (estimate / (1024 * 1024))
+                      << " MB) exceeds the seed budget; sorting seeds" << std::endl;
+        }
+    }
+
+    std::atomic<uint32_t> docs_scanned{0};
+    std::vector<std::vector<SeedRecord>> thread_buffers(num_threads);
+
+    // Sorts one thread's buffer and writes it as a run; called concurrently.
+    auto flush_buffer = [&](std::vector<SeedRecord>& buffer) {
         if (buffer.empty()) return;
         if (in_memory_only) return;
-        std::cout << "\n[LOG] Flushing " << buffer.size() << " seeds to disk... (RAM: "
-                  << get_current_rss_mb() << " MB)" << std::endl;
-        std::sort(std::execution::par, buffer.begin(), buffer.end(),
-                  [](const RawSeedEntry& a, const RawSeedEntry& b) {
-                      for (int i = 0; i < a.n; ++i) {
-                          uint32_t a_token = (a.is_dynamic) ? (*a.tokens.dynamic_tokens)[i]
-                                                            : a.tokens.fixed_tokens[i];
-                          uint32_t b_token = (b.is_dynamic) ? (*b.tokens.dynamic_tokens)[i]
-                                                            : b.tokens.fixed_tokens[i];
-                          if (a_token != b_token) return a_token < b_token;
-                      }
-                      return a.doc_id < b.doc_id;
-                  });
-        std::string fname = temp_dir + "/chunk_" + std::to_string(chunk_id++) + ".bin";
-        chunk_files.push_back(fname);
-        std::ofstream out(fname, std::ios::binary);
-        if (out) {
-            for (const auto& entry : buffer) {
-                entry.write_to_stream(out);
-            }
+        {
+            std::vector<SeedRecord> scratch;
+            radix_sort_seeds(buffer.data(), buffer.size(), scratch);
+        }
+        if (partitions) {
+            spilled_bytes += partitions->append(buffer.data(), buffer.size());
+        } else {
+            std::string fname = temp_dir + "/chunk_" + std::to_string(chunk_id++) + ".bin";
+            spilled_bytes += write_seed_run(fname, buffer.data(), buffer.size());
+            std::lock_guard<std::mutex> lock(chunk_mtx);
+            chunk_files.push_back(fname);
         }
+        spilled_records += buffer.size();
+        memory_accountant().release(MemComponent::SeedBuffers, buffer.size() * sizeof(SeedRecord));
         buffer.clear();
         buffer.shrink_to_fit();
     };
 
-    for (uint32_t d = 0; d < (uint32_t)doc_lengths.size(); ++d) {
-        // since this is memory intensive processing, we offload data to the files (chunks)
-        if (memory_limit_mb > 0 && get_current_rss_mb() >= (size_t)(memory_limit_mb * 0.75))
-            flush_buffer();
-        // fetch_doc fetches from the disk and caches in memory; with the --in-mem flag it does not use the disk
-        const auto& current_doc = corpus.get_doc(d);
-        if (current_doc.size() < (size_t)ngrams) continue;
-
-        for (uint32_t p = 0; p <= current_doc.size() - ngrams; ++p) {
-            total_processed++;
-            uint64_t h = hash_tokens(&current_doc[p], ngrams);
-
-            if (DEBUG) {
-                std::cout << "[DEBUG] Doc " << d << " Pos " << p << " Hash: " << h << std::endl;
-                std::cout << "[DEBUG] Tokens: ";
-                for (int k = 0; k < ngrams; ++k) {
-                    std::cout << id_to_word[current_doc[p + k]] << " ";
+    // After an overflow, a thread's table occurrences go back into its seed
+    // buffer (the table still maps slots to hashes until Step 1 ends).
+    auto untable_occurrences = [&](std::vector<SeedRecord>& buffer,
+                                   std::vector<SeedHashTable::Occurrence>& occs) {
+        for (const auto& o : occs) buffer.push_back({table->hash(o.slot), o.doc_id, o.pos});
+        memory_accountant().reserve(MemComponent::SeedBuffers, occs.size() * sizeof(SeedRecord));
+        memory_accountant().release(MemComponent::SeedTable, occs.size() * sizeof(SeedHashTable::Occurrence));
+        occ_bytes -= occs.size() * sizeof(SeedHashTable::Occurrence);
+        occs.clear();
+        occs.shrink_to_fit();
+    };
+
+    #pragma omp parallel reduction(+ : total_processed, seeds_passed, seeds_rejected)
+    {
+        auto& buffer = thread_buffers[omp_get_thread_num()];
+        auto& occs = thread_occs[omp_get_thread_num()];
+        std::vector<uint32_t> doc_slots;
+        const size_t thread_share = seed_budget_bytes / num_threads;
+
+        // Disk mode reads through a private stream: the shared doc cache
+        // serializes callers and its references may be evicted under us.
+        std::ifstream local_bin;
+        std::vector<uint32_t> local_doc;
+        std::vector<uint8_t> flags;
+        std::vector<TokenRun> runs;
+        if (!in_memory_only) local_bin.open(bin_corpus_path, std::ios::binary);
+
+        #pragma omp for schedule(dynamic, 16)
+        for (uint32_t d = 0; d < (uint32_t)doc_lengths.size(); ++d) {
+            if (table && !occs.empty() && table_overflow.load(std::memory_order_relaxed))
+                untable_occurrences(buffer, occs);
+
+            const std::vector<uint32_t>* doc_ptr = nullptr;
+            if (in_memory_only) {
+                doc_ptr = &corpus.get_doc(d);
+            } else {
+                local_doc.resize(doc_lengths[d]);
+                local_bin.seekg(doc_offsets[d]);
+                local_bin.read((char*)local_doc.data(), doc_lengths[d] * sizeof(uint32_t));
+                doc_ptr = &local_doc;
+            }
+            const auto& current_doc = *doc_ptr;
+
+            size_t seeds_before = buffer.size();
+            if (current_doc.size() >= (size_t)ngrams) {
+                size_t doc_windows = current_doc.size() - ngrams + 1;
+                total_processed += doc_windows;
+
+                const TokenRun* runs_begin;
+                const TokenRun* runs_end;
+                if (run_index.has_runs()) {
+                    runs_begin = run_index.runs_begin(d);
+                    runs_end = run_index.runs_end(d);
+                } else {
+                    runs.clear();
+                    run_index.scan(current_doc.data(), current_doc.size(), flags, runs);
+                    runs_begin = runs.data();
+                    runs_end = runs.data() + runs.size();
                 }
-                std::cout << std::endl;
-                std::cout << "[DEBUG] Filter Counter: "
-                          << (int)filter_counters[h % filter_size] << std::endl;
-                std::cout << std::endl;
-                std::cout << std::flush;
-            }
-
-            // Bloom Filter check. The BF is probabilistic, it uses a hash as an input which may have collisions
-            // we don't process ngrams until they reach min_docs or 255
-            if (filter_counters[h % filter_size] >= (uint8_t)std::min(min_docs, 255)) {
-                // DF check
-                // it is required because Bloom Filter is probabilistic and may produce false positives
-                bool df_ok = true;
-                for (int i = 0; i < ngrams; ++i) {
-                    if (word_df[current_doc[p + i]] < (uint32_t)min_docs) {
-                        df_ok = false;
-                        break;
+
+                // Windows outside the runs cover a rare token and are rejected
+                // without being hashed.
+                for (const TokenRun* r = runs_begin; r != runs_end; ++r) {
+                    for (uint32_t p = r->start; p + ngrams <= r->start + r->length; ++p) {
+                        // Cascade: text an earlier pass covered is not seeded.
+                        if (covered && covered->test(covered->position(d, p))) continue;
+                        uint64_t h = hash_tokens(&current_doc[p], ngrams);
+
+                        if (DEBUG) {
+                            #pragma omp critical(seed_debug)
+                            {
+                                std::cout << "[DEBUG] Doc " << d << " Pos " << p << " Hash: " << h << std::endl;
+                                std::cout << "[DEBUG] Tokens: ";
+                                for (int k = 0; k < ngrams; ++k) {
+                                    std::cout << id_to_word[current_doc[p + k]] << " ";
+                                }
+                                std::cout << std::endl;
+                                std::cout << "[DEBUG] Filter Counter: " << (filter ? (int)filter->count(h) : -1) << std::endl;
+                                std::cout << std::endl;
+                                std::cout << std::flush;
+                            }
+                        }
+
+                        // Bloom Filter check. The BF is probabilistic, it uses a hash as an input which may have collisions
+                        // we don't process ngrams until they reach min_docs or 255.
+                        // Every token of a run already passes the DF check.
+                        // In topk mode only the heavy hitters pass.
+                        if (filter ? filter->count(h) >= (uint8_t)bloom_threshold
+                                   : std::binary_search(heavy_keys.begin(), heavy_keys.end(), h)) {
+                            // saving the candidate in the thread's buffer; the tokens stay in the corpus
+                            buffer.push_back({h, d, p});
+                        }
+                    }
+                }
+                size_t accepted = buffer.size() - seeds_before;
+                seeds_passed += accepted;
+                seeds_rejected += doc_windows - accepted;
+
+                // Table mode: the document's seeds become table occurrences,
+                // with each distinct key counted once for this document.
+                if (table && accepted > 0 && !table_overflow.load(std::memory_order_relaxed)) {
+                    auto doc_begin = buffer.begin() + seeds_before;
+                    for (auto it = doc_begin; it != buffer.end(); ++it) table->prefetch(it->hash);
+                    std::sort(doc_begin, buffer.end());
+                    doc_slots.clear();
+                    bool full = false;
+                    for (auto it = doc_begin; it != buffer.end(); ++it) {
+                        if (it != doc_begin && it->hash == (it - 1)->hash) continue;
+                        uint32_t slot = table->insert(it->hash);
+                        if (slot == SeedHashTable::FULL) {
+                            full = true;
+                            break;
+                        }
+                        doc_slots.push_back(slot);
+                    }
+                    if (full) {
+                        table_overflow = true; // this document's seeds stay in the buffer
+                    } else {
+                        size_t k = 0;
+                        uint32_t in_doc = 0;
+                        for (auto it = doc_begin; it != buffer.end(); ++it) {
+                            if (it != doc_begin && it->hash != (it - 1)->hash) {
+                                table->add_doc(doc_slots[k++], in_doc);
+                                in_doc = 0;
+                            }
+                            occs.push_back({doc_slots[k], d, it->pos});
+                            in_doc++;
+                        }
+                        table->add_doc(doc_slots[k], in_doc);
+                        buffer.resize(seeds_before);
+                        size_t added = accepted * sizeof(SeedHashTable::Occurrence);
+                        size_t total = (occ_bytes += added);
+                        if (!memory_accountant().try_reserve(MemComponent::SeedTable, added)) {
+                            memory_accountant().reserve(MemComponent::SeedTable, added);
+                            table_overflow = true;
+                        }
+                        if (occ_budget_bytes > 0 && total > occ_budget_bytes) table_overflow = true;
                     }
                 }
+            }
 
-                if (df_ok) {
-                    // saving the candidate in the buffer (std::vector<RawSeedEntry>)
-                    RawSeedEntry entry;
-                    entry.init_tokens(ngrams);
-                    entry.n = ngrams;
-                    entry.doc_id = d;
-                    entry.pos = p;
-                    for (int i = 0; i < ngrams; ++i)
-                        entry.set_token(i, current_doc[p + i]);
-                    buffer.push_back(entry);
-                    seeds_passed++;
-                } else {
-                    seeds_rejected++;
+            // since this is memory intensive processing, we offload data to the files (chunks)
+            if (size_t added = (buffer.size() - seeds_before) * sizeof(SeedRecord)) {
+                bool fits = memory_accountant().try_reserve(MemComponent::SeedBuffers, added);
+                if (!fits) memory_accountant().reserve(MemComponent::SeedBuffers, added);
+                if (seed_budget_bytes > 0 &&
+                    (!fits || memory_accountant().used(MemComponent::SeedBuffers) >= seed_budget_bytes) &&
+                    buffer.size() * sizeof(SeedRecord) >= thread_share) {
+                    flush_buffer(buffer);
                 }
-            } else {
-                seeds_rejected++;
+            }
+
+            uint32_t done = ++docs_scanned;
+            if (done % 500 == 0 || done == doc_lengths.size()) {
+                #pragma omp critical(seed_progress)
+                std::cout << "[LOG] Scanning: " << done << "/" << doc_lengths.size() << " \r" << std::flush;
             }
         }
-        if (d % 500 == 0 || d == doc_lengths.size() - 1) {
-            std::cout << "[LOG] Scanning: " << (d + 1) << "/" << doc_lengths.size()
-                      << " | Seeds Found: " << seeds_passed << " \r" << std::flush;
+
+        if (table && !occs.empty() && table_overflow.load())
+            untable_occurrences(buffer, occs);
+        // Remaining seeds of every thread become one more run each.
+        flush_buffer(buffer);
+    }
+
+    if (table && table_overflow) {
+        std::cout << "\n[WARNING] Seed table overflowed (" << table->used()
+                  << " keys); fell back to sorting seeds" << std::endl;
+        table.reset();
+        thread_occs.clear();
+    }
+
+    std::vector<SeedRecord> buffer;
+    if (in_memory_only) {
+        buffer.reserve(seeds_passed);
+        for (auto& tb : thread_buffers) {
+            std::move(tb.begin(), tb.end(), std::back_inserter(buffer));
+            tb.clear();
+            tb.shrink_to_fit();
         }
     }
+    thread_buffers.clear();
 
     // Print Efficiency Statistics
     double efficiency = (total_processed > 0)
@@ -453,129 +615,323 @@ std::vector<Phrase> BloomNgramMiner::mine(const CorpusMiner& corpus,
     std::cout << "[BLOOM STATS] Rejected:    " << seeds_rejected
               << " (" << efficiency << "% reduction)" << std::endl;
 
-    filter_counters.clear();
-    filter_counters.shrink_to_fit();
-    if (in_memory_only) {
+    if (filter) filter->release();
+    if (table) {
+        std::cout << "[LOG] Seed table: " << table->used() << " keys, "
+                  << (occ_bytes.load() / (1024 * 1024)) << " MB of occurrences" << std::endl;
+    } else if (in_memory_only) {
         std::cout << "[LOG] In-Memory Mode: Sorting all " << buffer.size()
                   << " seeds in RAM..." << std::endl;
-        std::sort(std::execution::par, buffer.begin(), buffer.end(),
-                  [](const RawSeedEntry& a, const RawSeedEntry& b) {
-                      for (int i = 0; i < a.n; ++i) {
-                          uint32_t a_token = (a.is_dynamic) ? (*a.tokens.dynamic_tokens)[i]
-                                                            : a.tokens.fixed_tokens[i];
-                          uint32_t b_token = (b.is_dynamic) ? (*b.tokens.dynamic_tokens)[i]
-                                                            : b.tokens.fixed_tokens[i];
-                          if (a_token != b_token) return a_token < b_token;
-                      }
-                      if (a.doc_id != b.doc_id) return a.doc_id < b.doc_id;
-                      return a.pos < b.pos;
-                  });
+        // The sort needs a second array of the same size.
+        MemoryReservation sort_scratch(MemComponent::SeedBuffers, buffer.size() * sizeof(SeedRecord));
+        parallel_radix_sort_seeds(buffer);
     } else {
-        flush_buffer();
+        size_t raw_bytes = spilled_records.load() * sizeof(SeedRecord);
+        if (partitions && !partitions->close()) fatal_io_error("Writing seed partitions failed");
+        std::cout << "[LOG] Spilled " << (partitions ? std::to_string(partitions->partitions()) + " partitions"
+                                                    : std::to_string(chunk_files.size()) + " sorted runs")
+                  << " to " << temp_dir << ": "
+                  << (spilled_bytes.load() / (1024 * 1024)) << " MB encoded ("
+                  << (raw_bytes ? 100.0 * spilled_bytes.load() / raw_bytes : 0.0) << "% of raw)" << std::endl;
     }
     std::cout << std::endl;
 
     // --- START OF STEP 1.5 ---
     std::cout << "[LOG] Step 1.5: Merging and filtering candidates..." << std::endl;
-    std::vector<Phrase> candidates;
+    CandidateStore candidates;
+    // Set once the store is built; it stays accounted until mining returns.
+    MemoryReservation candidate_reservation(MemComponent::Candidates);
+
+    // Candidates are built into per-thread (or per-partition) sinks whose
+    // growth is reserved against --mem. A sink that cannot grow is spilled
+    // to a segment file; once anything has spilled (or with
+    // --candidates-on-disk), every candidate goes to disk and Step 2 writes
+    // them back in score order to one file that Step 3 streams.
+    struct CandidateSink {
+        CandidateStore store;
+        MemoryReservation reservation{MemComponent::Candidates};
+    };
+    struct CandidateSegment {
+        std::string path;
+        std::vector<uint64_t> offsets;
+    };
+    const std::string candidate_dir = temp_dir + "_candidates";
+    std::vector<CandidateSegment> segments;
+    std::mutex segment_mtx;
+    bool out_of_core = false;
+
+    auto spill_sink = [&](CandidateSink& sink) {
+        if (sink.store.empty()) return;
+        CandidateSegment segment;
+        size_t id;
+        {
+            std::lock_guard<std::mutex> lock(segment_mtx);
+            fs::create_directories(candidate_dir);
+            id = segments.size();
+            segments.emplace_back();
+        }
+        segment.path = candidate_dir + "/segment_" + std::to_string(id) + ".bin";
+        CandidateFileWriter out(segment.path);
+        segment.offsets.reserve(sink.store.size());
+        for (size_t i = 0; i < sink.store.size(); ++i)
+            segment.offsets.push_back(out.append(sink.store.support(i), sink.store.tokens(i), sink.store.occs(i)));
+        if (!out.close()) fatal_io_error("Short write to candidate file " + segment.path);
+        sink.store = CandidateStore();
+        sink.reservation.resize(0);
+
+        std::lock_guard<std::mutex> lock(segment_mtx);
+        segments[id] = std::move(segment);
+    };
 
-    if (in_memory_only) {
-        // --- PATH A: In-Memory Processing ---
+    auto same_ngram = [&](const SeedRecord& a, const SeedRecord& b) {
+        auto da = corpus.doc_view(a.doc_id);
+        auto db = corpus.doc_view(b.doc_id);
+        return std::equal(da.begin() + a.pos, da.begin() + a.pos + ngrams, db.begin() + b.pos);
+    };
+
+    auto make_candidate = [&](const SeedRecord* first, const SeedRecord* last, size_t support,
+                              CandidateSink& out) {
+        out.store.add(corpus.doc_view(first->doc_id).subspan(first->pos, ngrams), first, last, (uint32_t)support);
+        size_t bytes = out.store.memory_bytes();
+        if (bytes > out.reservation.bytes() && !out.reservation.try_resize(bytes)) spill_sink(out);
+    };
+
+    // Concatenates the sinks into `candidates`, or spills all of them when
+    // the store is out of core or the concatenated copy would not fit.
+    auto gather_candidates = [&](std::vector<CandidateSink>& parts) {
+        size_t bytes = 0;
+        for (const auto& part : parts) bytes += part.store.memory_bytes();
+        out_of_core = params.candidates_on_disk || !segments.empty();
+        MemoryReservation copy(MemComponent::Candidates);
+        if (!out_of_core) out_of_core = !copy.try_resize(bytes);
+        if (out_of_core) {
+            #pragma omp parallel for schedule(dynamic, 1)
+            for (size_t p = 0; p < parts.size(); ++p) spill_sink(parts[p]);
+            return;
+        }
+        std::vector<CandidateStore> stores;
+        stores.reserve(parts.size());
+        for (auto& part : parts) stores.push_back(std::move(part.store));
+        candidates.append_all(stores);
+        for (auto& part : parts) part.reservation.resize(0);
+        copy.resize(0);
+        candidate_reservation.resize(candidates.memory_bytes());
+    };
+
+    // Turns one run of equal hashes into candidates. Tokens are only read
+    // from the corpus here, for groups that already meet min_docs; a 64-bit
+    // collision splits the run by content. Scratch is per caller so that
+    // partitions can be grouped concurrently.
+    struct GroupScratch {
+        std::vector<SeedRecord> pending, rest;
+        size_t collisions = 0;
+    };
+    auto emit_hash_group = [&](const SeedRecord* first, const SeedRecord* last,
+                               CandidateSink& out, GroupScratch& scratch) {
+        if (!has_min_docs(first, last, min_docs)) return;
+
+        const SeedRecord* mismatch = first + 1;
+        while (mismatch != last && same_ngram(*first, *mismatch)) ++mismatch;
+        if (mismatch == last) {
+            make_candidate(first, last, count_distinct_docs(first, last), out);
+            return;
+        }
+
+        scratch.collisions++;
+        auto& pending = scratch.pending;
+        auto& rest = scratch.rest;
+        pending.assign(first, last);
+        while (!pending.empty()) {
+            auto split = std::stable_partition(pending.begin() + 1, pending.end(),
+                                               [&](const SeedRecord& r) { return same_ngram(pending[0], r); });
+            rest.assign(split, pending.end());
+            pending.erase(split, pending.end());
+            size_t support = count_distinct_docs(pending.data(), pending.data() + pending.size());
+            if (support >= (size_t)min_docs)
+                make_candidate(pending.data(), pending.data() + pending.size(), support, out);
+            pending.swap(rest);
+        }
+    };
+
+    // Groups a hash-sorted array run by run.
+    auto emit_sorted = [&](const SeedRecord* data, size_t n, CandidateSink& out, GroupScratch& scratch) {
         size_t i = 0;
-        while (i < buffer.size()) {
-            const RawSeedEntry& representative = buffer[i];
-            std::vector<Occurrence> current_occs;
-            std::unordered_set<uint32_t> unique_docs;
-
-            // Group identical tokens in the sorted RAM buffer
-            while (i < buffer.size() && buffer[i].same_tokens(representative)) {
-                current_occs.push_back({buffer[i].doc_id, buffer[i].pos});
-                unique_docs.insert(buffer[i].doc_id);
-                i++;
-            }
-
-            // Support check (min_docs)
-            if (unique_docs.size() >= (size_t)min_docs) {
-                std::vector<uint32_t> tokens_vec(ngrams);
-                for (int k = 0; k < ngrams; ++k) {
-                    tokens_vec[k] = (representative.is_dynamic)
-                                        ? (*representative.tokens.dynamic_tokens)[k]
-                                        : representative.tokens.fixed_tokens[k];
-                }
-                candidates.push_back(
-                    {tokens_vec, std::move(current_occs), unique_docs.size()});
+        while (i < n) {
+            size_t j = i + 1;
+            while (j < n && data[j].hash == data[i].hash) ++j;
+            emit_hash_group(data + i, data + j, out, scratch);
+            i = j;
+        }
+    };
+
+    GroupScratch group_scratch;
+
+    if (table) {
+        // --- PATH D: Seed Table ---
+        // Keys below min_docs are dropped without touching their
+        // occurrences. The rest are bucketed by slot in one scatter pass
+        // (the table knows each key's occurrence count); each bucket,
+        // ordered by (doc_id, pos), is exactly a run of equal hashes and goes
+        // through the same verification.
+        const size_t capacity = table->capacity();
+        constexpr size_t SKIP = SIZE_MAX;
+        std::vector<size_t> slot_start(capacity + 1);
+        std::vector<size_t> cursor(capacity);
+        size_t total = 0;
+        for (uint32_t slot = 0; slot < capacity; ++slot) {
+            slot_start[slot] = total;
+            if (table->docs(slot) >= (uint32_t)min_docs) {
+                cursor[slot] = total;
+                total += table->occurrences(slot);
+            } else {
+                cursor[slot] = SKIP;
             }
         }
-        // Free RAM immediately
-        buffer.clear();
-        buffer.shrink_to_fit();
-    } else {
-        // --- PATH B: Disk-Based External Merge ---
-        struct ChunkReader {
-            std::ifstream stream;
-            RawSeedEntry current;
-            bool active;
-            bool next() {
-                try {
-                    current.read_from_stream(stream);
-                    if (!stream) {
-                        active = false;
-                        return false;
-                    }
-                    return true;
-                } catch (...) {
-                    active = false;
-                    return false;
-                }
+        slot_start[capacity] = total;
+
+        std::vector<SeedRecord> grouped(total);
+        MemoryReservation grouped_reservation(MemComponent::SeedTable, total * sizeof(SeedRecord));
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (size_t t = 0; t < thread_occs.size(); ++t) {
+            for (const auto& o : thread_occs[t]) {
+                if (cursor[o.slot] == SKIP) continue;
+                size_t at = __atomic_fetch_add(&cursor[o.slot], (size_t)1, __ATOMIC_RELAXED);
+                grouped[at] = {0, o.doc_id, o.pos};
             }
-        };
-
-        auto cmp = [](ChunkReader* a, ChunkReader* b) { return a->current > b->current; };
-        std::priority_queue<ChunkReader*, std::vector<ChunkReader*>, decltype(cmp)> pq(cmp);
-        std::vector<std::unique_ptr<ChunkReader>> readers;
-
-        for (const auto& file : chunk_files) {
-            auto r = std::make_unique<ChunkReader>();
-            r->stream.open(file, std::ios::binary);
-            if (r->next()) {
-                r->active = true;
-                pq.push(r.get());
+            thread_occs[t].clear();
+            thread_occs[t].shrink_to_fit();
+        }
+        cursor.clear();
+        cursor.shrink_to_fit();
+        memory_accountant().release(MemComponent::SeedTable, occ_bytes.exchange(0));
+
+        std::vector<CandidateSink> thread_candidates(num_threads);
+        size_t collisions = 0;
+
+        #pragma omp parallel reduction(+ : collisions)
+        {
+            GroupScratch scratch;
+            auto& out = thread_candidates[omp_get_thread_num()];
+
+            #pragma omp for schedule(dynamic, 1024)
+            for (size_t slot = 0; slot < capacity; ++slot) {
+                SeedRecord* first = grouped.data() + slot_start[slot];
+                SeedRecord* last = grouped.data() + slot_start[slot + 1];
+                if (first == last) continue;
+                const uint64_t h = table->hash(slot);
+                for (SeedRecord* r = first; r != last; ++r) r->hash = h;
+                std::sort(first, last);
+                emit_hash_group(first, last, out, scratch);
             }
-            readers.push_back(std::move(r));
+            collisions += scratch.collisions;
         }
+        group_scratch.collisions += collisions;
+        table.reset();
+        gather_candidates(thread_candidates);
+        std::cout << "[LOG] Step 1.5: " << grouped.size() << " occurrences of frequent keys grouped" << std::endl;
+        grouped.clear();
+        grouped.shrink_to_fit();
 
-        while (!pq.empty()) {
-            RawSeedEntry representative = pq.top()->current;
-            std::vector<Occurrence> current_occs;
-            std::unordered_set<uint32_t> unique_docs;
-
-            while (!pq.empty() && pq.top()->current.same_tokens(representative)) {
-                ChunkReader* r = pq.top();
-                pq.pop();
+        try {
+            if (!in_memory_only) fs::remove_all(temp_dir);
+        } catch (const fs::filesystem_error& e) {
+            std::cerr << "[WARNING] Cleanup failed: " << e.what() << std::endl;
+        }
+    } else if (in_memory_only) {
+        // --- PATH A: In-Memory Processing ---
+        // The sorted buffer is cut into slices at hash boundaries, so that no
+        // group straddles two slices, and the slices are grouped in parallel.
+        const size_t n = buffer.size();
+        const size_t num_slices = n > 0 ? (size_t)num_threads * 8 : 0;
+        std::vector<size_t> cut(num_slices + 1, n);
+        for (size_t k = 0; k < num_slices; ++k) {
+            size_t at = std::max(k == 0 ? 0 : cut[k - 1], n / num_slices * k);
+            while (at > 0 && at < n && buffer[at].hash == buffer[at - 1].hash) ++at;
+            cut[k] = at;
+        }
+        std::vector<CandidateSink> slice_candidates(num_slices);
+        size_t collisions = 0;
 
-                current_occs.push_back({r->current.doc_id, r->current.pos});
-                unique_docs.insert(r->current.doc_id);
+        #pragma omp parallel reduction(+ : collisions)
+        {
+            GroupScratch scratch;
 
-                if (r->next()) pq.push(r);
+            #pragma omp for schedule(dynamic, 1)
+            for (size_t k = 0; k < num_slices; ++k)
+                emit_sorted(buffer.data() + cut[k], cut[k + 1] - cut[k], slice_candidates[k], scratch);
+            collisions += scratch.collisions;
+        }
+        group_scratch.collisions += collisions;
+        gather_candidates(slice_candidates);
+        // Free RAM immediately
+        memory_accountant().release(MemComponent::SeedBuffers, buffer.size() * sizeof(SeedRecord));
+        buffer.clear();
+        buffer.shrink_to_fit();
+    } else if (partitions) {
+        // --- PATH C: Hash Partitions ---
+        // Every n-gram lives in exactly one partition, so partitions are
+        // loaded, sorted and grouped independently, one per thread; there is
+        // no global merge and peak memory is set by the largest partition.
+        const size_t num_partitions = partitions->partitions();
+        std::vector<CandidateSink> partition_candidates(num_partitions);
+        size_t largest = 0;
+        size_t collisions = 0;
+
+        #pragma omp parallel reduction(max : largest) reduction(+ : collisions)
+        {
+            GroupScratch scratch;
+            std::vector<SeedRecord> seeds, sort_scratch;
+            MemoryReservation held(MemComponent::SeedBuffers);
+
+            #pragma omp for schedule(dynamic, 1)
+            for (size_t p = 0; p < num_partitions; ++p) {
+                seeds.clear();
+                seeds.reserve(partitions->records(p));
+                held.resize(2 * seeds.capacity() * sizeof(SeedRecord)); // plus sort scratch
+                read_seed_run(partitions->path(p), seeds);
+                fs::remove(partitions->path(p));
+                largest = std::max(largest, seeds.size());
+
+                radix_sort_seeds(seeds.data(), seeds.size(), sort_scratch);
+                emit_sorted(seeds.data(), seeds.size(), partition_candidates[p], scratch);
             }
+            collisions += scratch.collisions;
+        }
+        group_scratch.collisions += collisions;
+        gather_candidates(partition_candidates);
+        partitions.reset();
+        std::cout << "[LOG] Step 1.5: Grouped " << num_partitions << " partitions (largest "
+                  << largest << " seeds, " << (largest * sizeof(SeedRecord) / (1024 * 1024)) << " MB)"
+                  << std::endl;
 
-            if (unique_docs.size() >= (size_t)min_docs) {
-                std::vector<uint32_t> tokens_vec(ngrams);
-                for (int k = 0; k < ngrams; ++k) {
-                    tokens_vec[k] = (representative.is_dynamic)
-                                        ? (*representative.tokens.dynamic_tokens)[k]
-                                        : representative.tokens.fixed_tokens[k];
-                }
-                candidates.push_back(
-                    {tokens_vec, std::move(current_occs), unique_docs.size()});
-            }
+        try {
+            fs::remove_all(temp_dir);
+        } catch (const fs::filesystem_error& e) {
+            std::cerr << "[WARNING] Cleanup failed: " << e.what() << std::endl;
         }
+    } else {
+        // --- PATH B: Disk-Based External Merge ---
+        // Buffered run readers feed a loser tree; beyond merge_fan_in runs
+        // intermediate passes shrink the run count first.
+        SeedRunMerger merger(chunk_files, temp_dir, params.merge_fan_in);
+
+        std::vector<SeedRecord> group;
+        std::vector<CandidateSink> sink(1);
+        while (!merger.empty()) {
+            uint64_t group_hash = merger.top().hash;
+            group.clear();
+
+            while (!merger.empty() && merger.top().hash == group_hash) {
+                group.push_back(merger.top());
+                merger.pop();
+            }
 
-        // Cleanup Disk Resources
-        for (auto& r : readers) {
-            if (r->stream.is_open()) r->stream.close();
+            emit_hash_group(group.data(), group.data() + group.size(), sink[0], group_scratch);
         }
-        readers.clear();
+        gather_candidates(sink);
+        if (merger.passes() > 1)
+            std::cout << "[LOG] Step 1.5: " << merger.passes() << " merge passes (fan-in "
+                      << merger.fan_in() << ")" << std::endl;
 
         try {
             if (fs::exists(temp_dir)) {
@@ -587,126 +943,618 @@ std::vector<Phrase> BloomNgramMiner::mine(const CorpusMiner& corpus,
             std::cerr << "[WARNING] Cleanup failed: " << e.what() << std::endl;
         }
     }
+    if (group_scratch.collisions > 0)
+        std::cout << "[LOG] Step 1.5: " << group_scratch.collisions << " hash groups split by token content" << std::endl;
     // --- END OF STEP 1.5 ---
 
     size_t total_seeds_generated = candidates.size();
+    for (const auto& segment : segments) total_seeds_generated += segment.offsets.size();
     stop_timer(std::to_string(ngrams) + "-gram Seed Generation (Disk)", s1_start);
 
-    std::cout << "[LOG] Step 2: Sorting " << candidates.size()
+    std::cout << "[LOG] Step 2: Sorting " << total_seeds_generated
               << " candidates by score (support * length)..." << std::endl;
 
-    std::sort(std::execution::par, candidates.begin(), candidates.end(),
-              [](const Phrase& a, const Phrase& b) {
-                  size_t score_a = a.support * a.tokens.size();
-                  size_t score_b = b.support * b.tokens.size();
-
-                  if (score_a != score_b) {
-                      return score_a > score_b; // Сначала те, что покрывают больше текста
-                  }
-                  return a.support > b.support; // При равном весе — те, что чаще
-              });
+    // Only an index array is sorted; the candidates stay where they are.
+    std::vector<uint32_t> order;
+    // Out of core: record offsets of the score-ordered candidate file.
+    std::vector<uint64_t> ordered_offsets;
+    CandidateFile ordered;
+    if (!out_of_core) {
+        order = candidates.order_by_score();
+    } else {
+        // Sort compact keys of the segment records, then copy the records
+        // into one file in that order, so that Step 3 reads it front to back.
+        struct CandidateKey {
+            uint64_t score;
+            uint32_t support, doc_id, pos, segment;
+            uint64_t offset;
+        };
+        std::vector<CandidateFile> segment_files(segments.size());
+        std::vector<CandidateKey> keys;
+        keys.reserve(total_seeds_generated);
+        MemoryReservation key_reservation(MemComponent::Candidates, keys.capacity() * sizeof(CandidateKey));
+        for (uint32_t s = 0; s < segments.size(); ++s) {
+            if (!segment_files[s].open(segments[s].path))
+                fatal_io_error("Could not map candidate segment " + segments[s].path);
+            for (uint64_t offset : segments[s].offsets) {
+                const auto& h = segment_files[s].header(offset);
+                const Occurrence& first = segment_files[s].occs(offset)[0];
+                keys.push_back({(uint64_t)h.support * h.length, h.support, first.doc_id, first.pos, s, offset});
+            }
+        }
+        std::sort(std::execution::par, keys.begin(), keys.end(), [](const CandidateKey& a, const CandidateKey& b) {
+            if (a.score != b.score) return a.score > b.score;
+            if (a.support != b.support) return a.support > b.support;
+            if (a.doc_id != b.doc_id) return a.doc_id < b.doc_id;
+            return a.pos < b.pos;
+        });
+
+        const std::string ordered_path = candidate_dir + "/candidates.bin";
+        {
+            CandidateFileWriter out(ordered_path);
+            ordered_offsets.reserve(keys.size());
+            for (const auto& k : keys) {
+                const CandidateFile& f = segment_files[k.segment];
+                ordered_offsets.push_back(out.append(k.support, f.tokens(k.offset), f.occs(k.offset)));
+            }
+            if (!out.close()) fatal_io_error("Short write to candidate file " + ordered_path);
+        }
+        keys.clear();
+        keys.shrink_to_fit();
+        segment_files.clear();
+        for (const auto& segment : segments) fs::remove(segment.path);
+        segments.clear();
+
+        if (!ordered.open(ordered_path)) fatal_io_error("Could not map candidate file " + ordered_path);
+        candidate_reservation.resize(ordered_offsets.size() * sizeof(uint64_t) +
+                                     std::min(3 * CandidateFile::WINDOW_BYTES, ordered.mapped_bytes()));
+        std::cout << "[LOG] Step 2: Candidates stored out of core in " << ordered_path << " ("
+                  << (ordered.mapped_bytes() / (1024 * 1024)) << " MB)" << std::endl;
+    }
+    const size_t num_candidates = out_of_core ? ordered_offsets.size() : order.size();
+    auto candidate_occs = [&](size_t c) {
+        return out_of_core ? ordered.occs(ordered_offsets[c]) : candidates.occs(order[c]);
+    };
+    auto candidate_phrase = [&](size_t c) {
+        return out_of_core ? ordered.phrase(ordered_offsets[c]) : candidates.phrase(order[c]);
+    };
+    auto candidate_tokens = [&](size_t c) {
+        return out_of_core ? ordered.tokens(ordered_offsets[c]) : candidates.tokens(order[c]);
+    };
+    auto candidate_score = [&](size_t c) -> uint64_t {
+        if (!out_of_core) return candidates.score(order[c]);
+        const auto& h = ordered.header(ordered_offsets[c]);
+        return (uint64_t)h.support * h.length;
+    };
 
     std::cout << "[LOG] Step 3: Expanding with Path Compression (Jumps)..." << std::endl;
     auto s3_start = start_timer();
     std::vector<Phrase> final_phrases;
 
-    std::vector<std::vector<bool>> processed(doc_lengths.size());
-    for (size_t i = 0; i < doc_lengths.size(); ++i) {
-        processed[i].assign(doc_lengths[i], false);
-    }
+    // A cascade pass marks the caller's bitmap, which is accounted there.
+    std::unique_ptr<CoverageBitmap> own_processed;
+    if (!covered) own_processed = std::make_unique<CoverageBitmap>(doc_lengths);
+    CoverageBitmap& processed = covered ? *covered : *own_processed;
+    const size_t processed_bytes = covered ? 0 : processed.memory_bytes();
+    MemoryReservation expansion_reservation(MemComponent::Expansion, processed_bytes);
+
+    // Final phrases stay reserved until mine_pass() returns them; each
+    // batch's expanded phrases until the batch is committed.
+    size_t final_heap_bytes = 0;
+    MemoryReservation final_reservation(MemComponent::Expansion);
+    auto keep_phrase = [&](Phrase&& p) {
+        final_heap_bytes += phrase_bytes(p);
+        final_phrases.push_back(std::move(p));
+        final_reservation.resize(final_heap_bytes + final_phrases.capacity() * sizeof(Phrase));
+    };
 
-    for (size_t c_idx = 0; c_idx < candidates.size(); ++c_idx) {
-        if (g_stop_requested) {
-            std::cout << "\n[!] Expansion interrupted. Moving to save results..."
-                      << std::endl;
-            break;
+    auto is_covered = [&](std::span<const Occurrence> occs) {
+        for (auto& o : occs)
+            if (!processed.test(processed.position(o.doc_id, o.pos))) return false;
+        return true;
+    };
+    // Marks every occurrence's span; spans that are already covered are
+    // only read. Huge occurrence lists are marked by all threads.
+    auto mark_covered = [&](const Phrase& cand) {
+        const uint32_t len = (uint32_t)cand.tokens.size();
+        #pragma omp parallel for schedule(static) if (cand.occs.size() >= 65536)
+        for (size_t i = 0; i < cand.occs.size(); ++i) {
+            const Occurrence& o = cand.occs[i];
+            uint64_t first = processed.position(o.doc_id, o.pos);
+            uint32_t n = std::min(len, processed.doc_length(o.doc_id) - o.pos);
+            if (!processed.all_set(first, n)) processed.set_range(first, n);
         }
+    };
+
+    // Right-extends a candidate while some next word keeps min_docs, then
+    // extends it left while every occurrence has the same preceding token.
+    // Reads only the corpus, never the coverage mask, so candidates can be
+    // expanded concurrently.
+    // Per-thread buffers of the extension step, reused across steps and
+    // candidates so that extending allocates nothing once they have grown.
+    // A split step keeps each thread's sorted slice (`group`, `grouped`) and
+    // its per-word summary (`words`) here between phases.
+    struct WordGroup {
+        uint32_t word;
+        uint32_t occs;
+        uint32_t docs;
+        uint32_t first_doc;
+        uint32_t last_doc;
+    };
+    struct ExtensionScratch {
+        std::vector<uint64_t> keys, sorted; // next token << 32 | occurrence index
+        std::vector<Occurrence> next;
+        const uint64_t* group = nullptr;
+        size_t grouped = 0;
+        std::vector<WordGroup> words, merged;
+    };
+    std::vector<ExtensionScratch> extension_scratch(num_threads);
+
+    // Steps over at least split_step_occs occurrences use every thread, but
+    // only outside a parallel region: inside a speculative batch the step
+    // would run on one thread anyway, so such candidates are deferred.
+    const bool parallel_expansion = num_threads > 1;
+    const size_t split_step_occs = parallel_expansion ? params.split_step_occs : 0;
+    auto split_step = [&](const Phrase& cand) {
+        return split_step_occs > 0 && cand.occs.size() >= split_step_occs && !omp_in_parallel();
+    };
 
-        if (c_idx % 100 == 0 || c_idx == candidates.size() - 1) {
-            std::cout << "[LOG] Expanding: " << (c_idx + 1) << "/" << candidates.size()
-                      << " | Phrases found: " << final_phrases.size()
-                      << "          \r" << std::flush;
+    // Gathers the (next token, occurrence index) pairs of occs[begin, end)
+    // into scratch.keys and groups them by token; returns the key count and
+    // leaves the grouped keys at scratch.group.
+    auto gather_and_group = [&](ExtensionScratch& scratch, const Phrase& cand, uint32_t begin, uint32_t end) {
+        const uint32_t len = (uint32_t)cand.tokens.size();
+        auto& keys = scratch.keys;
+        keys.resize(end - begin);
+        size_t m = 0;
+        for (uint32_t i = begin; i < end; ++i) {
+            const Occurrence& o = cand.occs[i];
+            auto doc = corpus.doc_view(o.doc_id);
+            if (o.pos + len < doc.size()) keys[m++] = (uint64_t)doc[o.pos + len] << 32 | i;
         }
 
-        auto& cand = candidates[c_idx];
+        // Group by next token with a stable LSD counting sort on the token
+        // bytes (passes where every key has the same byte are skipped);
+        // short lists just use std::sort.
+        scratch.group = keys.data();
+        scratch.grouped = m;
+        if (m <= 64) {
+            std::sort(keys.begin(), keys.begin() + m);
+            return m;
+        }
+        scratch.sorted.resize(m);
+        uint64_t* in = keys.data();
+        uint64_t* out = scratch.sorted.data();
+        for (int shift = 32; shift < 64; shift += 8) {
+            size_t count[257] = {0};
+            for (size_t k = 0; k < m; ++k) count[((in[k] >> shift) & 0xFF) + 1]++;
+            if (count[((in[0] >> shift) & 0xFF) + 1] == m) continue;
+            for (int b = 0; b < 256; ++b) count[b + 1] += count[b];
+            for (size_t k = 0; k < m; ++k) out[count[(in[k] >> shift) & 0xFF]++] = in[k];
+            std::swap(in, out);
+        }
+        scratch.group = in;
+        return m;
+    };
 
-        bool all_processed = true;
-        for (auto& o : cand.occs) {
-            if (!processed[o.doc_id][o.pos]) {
-                all_processed = false;
-                break;
+    // Jump: the number of tokens that follow every occurrence identically.
+    // Over that stretch a per-token step would see a single group holding
+    // all occurrences and take it, so the phrase can advance in one go and
+    // only regroup where the continuations branch (or a document ends).
+    auto common_continuation = [&](const Phrase& cand, bool split) -> size_t {
+        const uint32_t len = (uint32_t)cand.tokens.size();
+        const Occurrence& ref = cand.occs[0];
+        auto ref_doc = corpus.doc_view(ref.doc_id);
+        const uint32_t* ref_next = ref_doc.data() + ref.pos + len;
+        size_t limit = ref_doc.size() - (ref.pos + len);
+        #pragma omp parallel if (split)
+        {
+            size_t local = limit;
+            #pragma omp for schedule(static)
+            for (size_t i = 1; i < cand.occs.size(); ++i) {
+                if (local == 0) continue;
+                const Occurrence& o = cand.occs[i];
+                auto doc = corpus.doc_view(o.doc_id);
+                local = common_prefix_length(doc.data() + o.pos + len, ref_next,
+                                             std::min(local, doc.size() - (o.pos + len)));
             }
+            #pragma omp critical(common_continuation)
+            limit = std::min(limit, local);
         }
-        if (all_processed) continue;
+        return limit;
+    };
 
-        while (true) {
-            std::unordered_map<uint32_t, std::vector<Occurrence>> next_word_occs;
-            for (auto& o : cand.occs) {
-                const auto& doc = corpus.get_doc(o.doc_id);
-                uint32_t np = o.pos + (uint32_t)cand.tokens.size();
-                if (np < doc.size()) {
-                    next_word_occs[doc[np]].push_back(o);
+    // Left closure: the number of tokens that precede every occurrence
+    // identically. Right extension only narrows the occurrences, so a phrase
+    // that cannot grow right stays so once these tokens are prepended.
+    auto common_precedence = [&](const Phrase& cand, bool split) -> size_t {
+        const Occurrence& ref = cand.occs[0];
+        const uint32_t* ref_prev = corpus.doc_view(ref.doc_id).data() + ref.pos;
+        size_t limit = ref.pos;
+        #pragma omp parallel if (split)
+        {
+            size_t local = limit;
+            #pragma omp for schedule(static)
+            for (size_t i = 1; i < cand.occs.size(); ++i) {
+                if (local == 0) continue;
+                const Occurrence& o = cand.occs[i];
+                local = common_suffix_length(corpus.doc_view(o.doc_id).data() + o.pos, ref_prev,
+                                             std::min<size_t>(local, o.pos));
+            }
+            #pragma omp critical(common_precedence)
+            limit = std::min(limit, local);
+        }
+        return limit;
+    };
+
+    // One extension step over all threads. Each thread groups a contiguous
+    // slice of the occurrences and summarises its words; the summaries are
+    // reduced pairwise, neighbouring slices first, so a document cut by a
+    // slice boundary is counted once (doc_ids are non-decreasing along the
+    // occurrences). The winner's occurrences are then copied back slice by
+    // slice, which keeps them in order. Same choice as the serial step.
+    auto extend_split = [&](Phrase& cand) {
+        const uint32_t n = (uint32_t)cand.occs.size();
+        const int slices = num_threads;
+        size_t total = 0;
+        #pragma omp parallel for schedule(static) reduction(+ : total)
+        for (int t = 0; t < slices; ++t) {
+            ExtensionScratch& scratch = extension_scratch[t];
+            const size_t m = gather_and_group(scratch, cand, (uint64_t)n * t / slices, (uint64_t)n * (t + 1) / slices);
+            total += m;
+            scratch.words.clear();
+            for (size_t a = 0; a < m;) {
+                const uint32_t word = (uint32_t)(scratch.group[a] >> 32);
+                WordGroup g{word, 0, 0, cand.occs[(uint32_t)scratch.group[a]].doc_id, 0};
+                size_t b = a;
+                for (; b < m && (uint32_t)(scratch.group[b] >> 32) == word; ++b) {
+                    uint32_t doc_id = cand.occs[(uint32_t)scratch.group[b]].doc_id;
+                    if (b == a || doc_id != g.last_doc) g.docs++;
+                    g.last_doc = doc_id;
+                }
+                g.occs = (uint32_t)(b - a);
+                scratch.words.push_back(g);
+                a = b;
+            }
+        }
+        if (total < (size_t)min_docs) return false;
+
+        for (int stride = 1; stride < slices; stride *= 2) {
+            #pragma omp parallel for schedule(dynamic, 1)
+            for (int t = 0; t < slices - stride; t += 2 * stride) {
+                const auto& left = extension_scratch[t].words;
+                const auto& right = extension_scratch[t + stride].words;
+                auto& out = extension_scratch[t].merged;
+                out.clear();
+                size_t i = 0, j = 0;
+                while (i < left.size() || j < right.size()) {
+                    if (j == right.size() || (i < left.size() && left[i].word < right[j].word)) {
+                        out.push_back(left[i++]);
+                    } else if (i == left.size() || right[j].word < left[i].word) {
+                        out.push_back(right[j++]);
+                    } else {
+                        WordGroup g = left[i++];
+                        const WordGroup& r = right[j++];
+                        g.docs += r.docs - (g.last_doc == r.first_doc);
+                        g.occs += r.occs;
+                        g.last_doc = r.last_doc;
+                        out.push_back(g);
+                    }
                 }
+                extension_scratch[t].words.swap(out);
+            }
+        }
+
+        uint32_t best_word = 0;
+        size_t max_support = 0;
+        for (const WordGroup& g : extension_scratch[0].words) {
+            if (g.docs >= (size_t)min_docs && g.docs > max_support) {
+                max_support = g.docs;
+                best_word = g.word;
+            }
+        }
+        if (max_support == 0) return false;
+
+        std::vector<size_t> offset(slices + 1, 0);
+        std::vector<const uint64_t*> winner(slices);
+        #pragma omp parallel for schedule(static)
+        for (int t = 0; t < slices; ++t) {
+            const ExtensionScratch& scratch = extension_scratch[t];
+            const uint64_t* end = scratch.group + scratch.grouped;
+            winner[t] = std::lower_bound(scratch.group, end, (uint64_t)best_word << 32);
+            const uint64_t* stop = winner[t];
+            while (stop != end && (uint32_t)(*stop >> 32) == best_word) ++stop;
+            offset[t + 1] = stop - winner[t];
+        }
+        for (int t = 0; t < slices; ++t) offset[t + 1] += offset[t];
+        auto& next = extension_scratch[0].next;
+        next.resize(offset[slices]);
+        #pragma omp parallel for schedule(static)
+        for (int t = 0; t < slices; ++t)
+            for (size_t k = offset[t]; k < offset[t + 1]; ++k) next[k] = cand.occs[(uint32_t)winner[t][k - offset[t]]];
+        cand.tokens.push_back(best_word);
+        cand.occs.swap(extension_scratch[0].next);
+        cand.support = max_support;
+        return true;
+    };
+
+    auto expand_candidate = [&](Phrase& cand) {
+        ExtensionScratch& scratch = extension_scratch[omp_get_thread_num()];
+        while (true) {
+            const bool split = split_step(cand);
+            if (size_t jump = common_continuation(cand, split)) {
+                const Occurrence& ref = cand.occs[0];
+                const uint32_t* next = corpus.doc_view(ref.doc_id).data() + ref.pos + cand.tokens.size();
+                cand.tokens.insert(cand.tokens.end(), next, next + jump);
+            }
+            if (split) {
+                if (!extend_split(cand)) break;
+                continue;
             }
 
+            // Indices follow the doc_id order of the occurrences.
+            const size_t m = gather_and_group(scratch, cand, 0, (uint32_t)cand.occs.size());
+            if (m < (size_t)min_docs) break;
+            const uint64_t* group = scratch.group;
+
+            // Distinct documents of a group are the doc_id changes along its
+            // indices. Ties go to the smallest token, so the choice does not
+            // depend on hashing.
             uint32_t best_word = 0;
-            size_t max_support = 0;
-            std::vector<Occurrence> best_next_occs;
-
-            for (auto& [word, occs] : next_word_occs) {
-                std::unordered_set<uint32_t> unique_docs;
-                for (auto& o : occs) unique_docs.insert(o.doc_id);
-
-                if (unique_docs.size() >= (size_t)min_docs &&
-                    unique_docs.size() >= max_support) {
-                    max_support = unique_docs.size();
-                    best_word = word;
-                    best_next_occs = std::move(occs);
+            size_t max_support = 0, best_first = 0, best_last = 0;
+            for (size_t a = 0; a < m;) {
+                const uint32_t word = (uint32_t)(group[a] >> 32);
+                size_t b = a + 1;
+                while (b < m && (uint32_t)(group[b] >> 32) == word) ++b;
+                // The occurrence count bounds the support: words that cannot
+                // reach min_docs or beat the current best are not counted.
+                if (b - a >= (size_t)min_docs && b - a > max_support) {
+                    size_t unique_docs = 0;
+                    uint32_t prev_doc = 0;
+                    for (size_t k = a; k < b; ++k) {
+                        uint32_t doc_id = cand.occs[(uint32_t)group[k]].doc_id;
+                        if (k == a || doc_id != prev_doc) ++unique_docs;
+                        prev_doc = doc_id;
+                    }
+                    if (unique_docs >= (size_t)min_docs && unique_docs > max_support) {
+                        max_support = unique_docs;
+                        best_word = word;
+                        best_first = a;
+                        best_last = b;
+                    }
                 }
+                a = b;
             }
 
-            if (max_support > 0) {
-                cand.tokens.push_back(best_word);
-                cand.occs = std::move(best_next_occs);
-                cand.support = max_support;
-            } else break;
+            if (max_support == 0) break;
+            scratch.next.clear();
+            for (size_t k = best_first; k < best_last; ++k) scratch.next.push_back(cand.occs[(uint32_t)group[k]]);
+            cand.tokens.push_back(best_word);
+            cand.occs.swap(scratch.next);
+            cand.support = max_support;
         }
 
-        if (!cand.occs.empty()) {
-                    bool has_common_prefix = false;
-                    uint32_t first_doc = cand.occs[0].doc_id;
-                    int first_pos = (int)cand.occs[0].pos;
+        // A phrase that is not closed on the left is extended, not dropped,
+        // so its expansion is kept and its full span gets marked.
+        if (size_t back = common_precedence(cand, split_step(cand))) {
+            const Occurrence& ref = cand.occs[0];
+            const uint32_t* prev = corpus.doc_view(ref.doc_id).data() + ref.pos - back;
+            cand.tokens.insert(cand.tokens.begin(), prev, prev + back);
+            for (Occurrence& o : cand.occs) o.pos -= (uint32_t)back;
+        }
+    };
 
-                    if (first_pos > 0) {
-                        uint32_t common_prev = corpus.get_doc(first_doc)[first_pos - 1];
-                        bool all_match = true;
-                        for (const auto& o : cand.occs) {
-                            if (o.pos == 0 || corpus.get_doc(o.doc_id)[o.pos - 1] != common_prev) {
-                                all_match = false;
-                                break;
-                            }
-                        }
-                        if (all_match) has_common_prefix = true;
-                    }
+    // Speculative batches: the candidates of a batch that are not yet
+    // covered are expanded in parallel against the mask as it was when the
+    // batch started, then committed one by one in score order (marks use
+    // atomic fetch-or, but commits stay serial to keep the order). A candidate
+    // covered by an earlier commit of the same batch is dropped, exactly as
+    // the serial loop would have skipped it, so the phrases emitted are the
+    // serial greedy result for any batch size; only the discarded
+    // expansions are wasted work.
+    const size_t batch_size = !parallel_expansion  ? 1
+                              : params.expansion_batch ? params.expansion_batch
+                                                       : (size_t)num_threads * 32;
+    enum class Outcome : uint8_t { Pending, Covered, Deferred, Expanded };
+    std::vector<Outcome> outcome(batch_size);
+    std::vector<Phrase> expanded(batch_size);
+    MemoryReservation batch_reservation(MemComponent::Expansion, batch_size * sizeof(Phrase));
+    size_t speculative_waste = 0;
+    bool interrupted = false;
+
+    // Lazy rescoring: candidates are popped from a max-heap keyed by score
+    // (ties keep the Step 2 order). A popped candidate is rescored on its
+    // live occurrences, those whose start is not yet covered; it is dropped
+    // below min_docs, pushed back if it now scores below the next key, and
+    // otherwise expanded from its live occurrences only. The heap gives up
+    // the speculative batches and streams the on-disk store in heap order.
+    // Disk mode: the documents the next batches will read (at least
+    // PREFETCH_CANDIDATES candidates ahead) are requested from the mapped
+    // corpus up front, in file order and coalesced, rather than faulted in
+    // one page at a time by the expansion threads.
+    constexpr size_t PREFETCH_CANDIDATES = 256;
+    const bool prefetch_docs = !corpus.is_in_memory_only();
+    std::vector<uint32_t> batch_docs;
+    size_t prefetched = 0;
+    auto add_batch_docs = [&](std::span<const Occurrence> occs) {
+        for (const Occurrence& o : occs)
+            if (batch_docs.empty() || batch_docs.back() != o.doc_id) batch_docs.push_back(o.doc_id);
+    };
 
-                    if (has_common_prefix) {
-                        continue; // Skip this phrase: it is not backward-closed
-                    }
+    size_t requeued = 0, dropped = 0, overlapping = 0;
+    // The left closure can move a phrase's starts onto text an earlier
+    // commit covered: another seed inside the same longer phrase already
+    // produced it. Such expansions are not committed again.
+    size_t closed_duplicates = 0;
+    if (params.rescore_candidates) {
+        struct HeapEntry {
+            uint64_t score;
+            uint32_t c;
+        };
+        auto below = [](const HeapEntry& a, const HeapEntry& b) {
+            return a.score != b.score ? a.score < b.score : a.c > b.c;
+        };
+        std::vector<HeapEntry> heap(num_candidates);
+        for (size_t c = 0; c < num_candidates; ++c) heap[c] = {candidate_score(c), (uint32_t)c};
+        std::make_heap(heap.begin(), heap.end(), below);
+        expansion_reservation.resize(processed_bytes + heap.size() * sizeof(HeapEntry));
+
+        size_t popped = 0;
+        while (!heap.empty()) {
+            if (g_stop_requested) {
+                std::cout << "\n[!] Expansion interrupted. Moving to save results..." << std::endl;
+                interrupted = true;
+                break;
+            }
+            if (popped++ % 1000 == 0) {
+                std::cout << "[LOG] Expanding: " << popped << " popped, " << heap.size() << " queued"
+                          << " | Phrases found: " << final_phrases.size() << "          \r" << std::flush;
+            }
+            std::pop_heap(heap.begin(), heap.end(), below);
+            const HeapEntry top = heap.back();
+            heap.pop_back();
+
+            Phrase cand;
+            for (const Occurrence& o : candidate_occs(top.c))
+                if (!processed.test(processed.position(o.doc_id, o.pos))) cand.occs.push_back(o);
+            cand.support = count_distinct_docs(cand.occs.data(), cand.occs.data() + cand.occs.size());
+            if (cand.support < (size_t)min_docs) {
+                dropped++;
+                continue;
+            }
+            auto tokens = candidate_tokens(top.c);
+            const uint64_t score = (uint64_t)cand.support * tokens.size();
+            if (!heap.empty() && score < heap.front().score) {
+                heap.push_back({score, top.c});
+                std::push_heap(heap.begin(), heap.end(), below);
+                requeued++;
+                continue;
+            }
+
+            if (prefetch_docs) {
+                batch_docs.clear();
+                add_batch_docs(cand.occs);
+                corpus.prefetch_docs(batch_docs);
+            }
+            cand.tokens.assign(tokens.begin(), tokens.end());
+            expand_candidate(cand);
+            // Keys use the seed length, so a short seed can be popped before
+            // the seeds of a longer phrase that contains it. Only occurrences
+            // whose whole expanded span is still uncovered are kept; without
+            // min_docs of them the expansion overlaps committed text.
+            const uint32_t len = (uint32_t)cand.tokens.size();
+            cand.occs.erase(std::remove_if(cand.occs.begin(), cand.occs.end(),
+                                           [&](const Occurrence& o) {
+                                               uint32_t n = std::min(len, processed.doc_length(o.doc_id) - o.pos);
+                                               return processed.any_set(processed.position(o.doc_id, o.pos), n);
+                                           }),
+                            cand.occs.end());
+            cand.support = count_distinct_docs(cand.occs.data(), cand.occs.data() + cand.occs.size());
+            if (cand.support < (size_t)min_docs) {
+                overlapping++;
+                continue;
+            }
+            mark_covered(cand);
+            if (cand.tokens.size() >= (size_t)params.min_l) keep_phrase(std::move(cand));
+        }
+    } else {
+        for (size_t first = 0; first < num_candidates && !interrupted; first += batch_size) {
+            const size_t last = std::min(num_candidates, first + batch_size);
+            if (first == 0 || last / 100 != first / 100 || last == num_candidates) {
+                std::cout << "[LOG] Expanding: " << last << "/" << num_candidates
+                          << " | Phrases found: " << final_phrases.size()
+                          << "          \r" << std::flush;
+            }
+            if (out_of_core) ordered.advise(ordered_offsets[first]);
+            if (prefetch_docs && first >= prefetched) {
+                prefetched = std::min(num_candidates, first + std::max(batch_size, PREFETCH_CANDIDATES));
+                batch_docs.clear();
+                for (size_t c = first; c < prefetched; ++c) {
+                    auto occs = candidate_occs(c);
+                    if (!is_covered(occs)) add_batch_docs(occs);
+                }
+                corpus.prefetch_docs(batch_docs);
+            }
+
+            #pragma omp parallel for schedule(dynamic, 1) if (parallel_expansion && last - first > 1)
+            for (size_t c = first; c < last; ++c) {
+                const size_t i = c - first;
+                outcome[i] = Outcome::Pending;
+                if (g_stop_requested) continue;
+                if (is_covered(candidate_occs(c))) {
+                    outcome[i] = Outcome::Covered;
+                    continue;
+                }
+                if (split_step_occs > 0 && candidate_occs(c).size() >= split_step_occs) {
+                    outcome[i] = Outcome::Deferred;
+                    continue;
+                }
+                expanded[i] = candidate_phrase(c);
+                expand_candidate(expanded[i]);
+                outcome[i] = Outcome::Expanded;
+            }
+            for (size_t c = first; c < last; ++c) {
+                const size_t i = c - first;
+                if (outcome[i] != Outcome::Deferred) continue;
+                if (g_stop_requested) {
+                    outcome[i] = Outcome::Pending;
+                    continue;
+                }
+                expanded[i] = candidate_phrase(c);
+                expand_candidate(expanded[i]);
+                outcome[i] = Outcome::Expanded;
+            }
+            size_t batch_heap_bytes = 0;
+            for (size_t i = 0; i < last - first; ++i)
+                if (outcome[i] == Outcome::Expanded) batch_heap_bytes += phrase_bytes(expanded[i]);
+            batch_reservation.resize(batch_size * sizeof(Phrase) + batch_heap_bytes);
+
+            for (size_t c = first; c < last; ++c) {
+                const size_t i = c - first;
+                if (outcome[i] == Outcome::Pending) {
+                    std::cout << "\n[!] Expansion interrupted. Moving to save results..."
+                              << std::endl;
+                    interrupted = true;
+                    break;
+                }
+                if (outcome[i] != Outcome::Expanded) continue;
+                Phrase& cand = expanded[i];
+                if (is_covered(candidate_occs(c))) {
+                    speculative_waste++;
+                    continue;
+                }
+                if (is_covered(cand.occs)) {
+                    closed_duplicates++;
+                    continue;
                 }
 
-        for (auto& o : cand.occs) {
-            for (uint32_t i = 0; i < (uint32_t)cand.tokens.size(); ++i) {
-                if (o.pos + i < processed[o.doc_id].size())
-                    processed[o.doc_id][o.pos + i] = true;
+                mark_covered(cand);
+                if (cand.tokens.size() >= (size_t)params.min_l) keep_phrase(std::move(cand));
             }
+            for (size_t i = 0; i < last - first; ++i) expanded[i] = Phrase();
+            batch_reservation.resize(batch_size * sizeof(Phrase));
         }
-        if (cand.tokens.size() >= (size_t)params.min_l) {
-             final_phrases.push_back(std::move(cand));
-         }
     }
     std::cout << std::endl;
+    if (speculative_waste > 0)
+        std::cout << "[LOG] Step 3: " << speculative_waste << " speculative expansions discarded at commit"
+                  << " (batch " << batch_size << ")" << std::endl;
+    if (closed_duplicates > 0)
+        std::cout << "[LOG] Step 3: " << closed_duplicates << " left-closed phrases already covered, skipped"
+                  << std::endl;
+    if (params.rescore_candidates)
+        std::cout << "[LOG] Step 3: " << requeued << " candidates re-queued after rescoring, " << dropped
+                  << " dropped below min_docs, " << overlapping << " overlapping committed phrases" << std::endl;
     stop_timer("Expansion & Pruning", s3_start);
 
+    if (out_of_core) {
+        try {
+            fs::remove_all(candidate_dir);
+        } catch (const fs::filesystem_error& e) {
+            std::cerr << "[WARNING] Cleanup failed: " << e.what() << std::endl;
+        }
+    }
+
     size_t count_6plus = 0;
     for (const auto& p : final_phrases)
         if (p.tokens.size() >= 6) count_6plus++;
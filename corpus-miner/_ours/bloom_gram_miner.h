@@ -3,6 +3,8 @@
 #include "../mining_algorithm.h"
 #include "../corpus_miner.h"
 
+class CoverageBitmap;
+
 // Your existing n-gram + Bloom + expansion miner, refactored into a class
 class BloomNgramMiner : public IMiningAlgorithm {
 public:
@@ -10,4 +12,24 @@ public:
 
     std::vector<Phrase> mine(const CorpusMiner& corpus,
                              const MiningParams& params) override;
+
+    // Hands over the --fused-bloom sketch the loader counted for
+    // `ngrams`-grams; the pass with that seed length uses it once.
+    void set_ngram_sketch(std::unique_ptr<CountingBloomFilter> sketch, int ngrams, bool capped) {
+        ngram_sketch = std::move(sketch);
+        sketch_ngrams = ngrams;
+        sketch_capped = capped;
+    }
+
+private:
+    std::unique_ptr<CountingBloomFilter> ngram_sketch;
+    int sketch_ngrams = 0;
+    bool sketch_capped = false;
+
+    // One Bloom/seed/expand pass with params.ngrams-long seeds. Given a
+    // shared coverage bitmap, windows that start on covered text are not
+    // seeded and Step 3 marks into it, so a later pass only mines what
+    // earlier ones left uncovered.
+    std::vector<Phrase> mine_pass(const CorpusMiner& corpus, const MiningParams& params,
+                                  CoverageBitmap* covered);
 };
@@ -0,0 +1,98 @@
+#include "candidate_file.h"
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+CandidateFileWriter::CandidateFileWriter(const std::string& path) {
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) std::cerr << "[ERROR] Could not create candidate file " << path << std::endl;
+    buffer.reserve(BUFFER_BYTES);
+}
+
+CandidateFileWriter::~CandidateFileWriter() { close(); }
+
+void CandidateFileWriter::put(const void* data, size_t n) {
+    const char* p = (const char*)data;
+    while (n > 0) {
+        size_t take = std::min(n, BUFFER_BYTES - buffer.size());
+        buffer.insert(buffer.end(), p, p + take);
+        p += take;
+        n -= take;
+        if (buffer.size() == BUFFER_BYTES) flush();
+    }
+}
+
+void CandidateFileWriter::flush() {
+    const char* p = buffer.data();
+    size_t n = buffer.size();
+    while (n > 0 && fd >= 0) {
+        ssize_t w = ::write(fd, p, n);
+        if (w <= 0) {
+            failed = true;
+            break;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    written += buffer.size();
+    buffer.clear();
+}
+
+uint64_t CandidateFileWriter::append(uint32_t support, std::span<const uint32_t> tokens,
+                                     std::span<const Occurrence> occs) {
+    uint64_t offset = bytes();
+    CandidateRecordHeader h{support, (uint32_t)tokens.size(), (uint32_t)occs.size()};
+    put(&h, sizeof(h));
+    put(tokens.data(), tokens.size_bytes());
+    put(occs.data(), occs.size_bytes());
+    return offset;
+}
+
+bool CandidateFileWriter::close() {
+    if (fd < 0) return false;
+    flush();
+    ::close(fd);
+    fd = -1;
+    return !failed;
+}
+
+CandidateFile::~CandidateFile() {
+    if (base) munmap((void*)base, bytes);
+}
+
+bool CandidateFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "[ERROR] Could not open candidate file " << path << std::endl;
+        return false;
+    }
+    size_t size = (size_t)lseek(fd, 0, SEEK_END);
+    if (size > 0) {
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            std::cerr << "[ERROR] mmap of candidate file " << path << " failed" << std::endl;
+            ::close(fd);
+            return false;
+        }
+        base = (const char*)addr;
+        bytes = size;
+        madvise(addr, size, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+    return true;
+}
+
+void CandidateFile::advise(uint64_t offset) {
+    size_t w = offset / WINDOW_BYTES;
+    if (w == window || !base) return;
+    window = w;
+    auto range = [&](size_t i, int advice) {
+        size_t start = i * WINDOW_BYTES;
+        if (start >= bytes) return;
+        madvise((void*)(base + start), std::min(WINDOW_BYTES, bytes - start), advice);
+    };
+    range(w + 1, MADV_WILLNEED);
+    if (w >= 2) range(w - 2, MADV_DONTNEED);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+#include "../types.h"
+
+// On-disk candidate store, used when the candidates of Step 1.5 do not fit
+// under --mem. A file is a sequence of records
+//
+//   uint32 support, uint32 length, uint32 occ_count,
+//   uint32 tokens[length], Occurrence occs[occ_count]
+//
+// so each candidate's occurrence list is contiguous. Record offsets are kept
+// in memory by whoever writes the file. Spilled segments of Step 1.5 use the
+// same format in build order; the final file is rewritten in score order and
+// streamed by Step 3.
+
+struct CandidateRecordHeader {
+    uint32_t support;
+    uint32_t length;
+    uint32_t occ_count;
+};
+
+// Buffered append-only writer; append() returns the record's offset.
+class CandidateFileWriter {
+public:
+    explicit CandidateFileWriter(const std::string& path);
+    ~CandidateFileWriter();
+    CandidateFileWriter(const CandidateFileWriter&) = delete;
+    CandidateFileWriter& operator=(const CandidateFileWriter&) = delete;
+
+    uint64_t append(uint32_t support, std::span<const uint32_t> tokens, std::span<const Occurrence> occs);
+    // Flushes the buffer; returns false on any write error.
+    bool close();
+    uint64_t bytes() const { return written + buffer.size(); }
+
+private:
+    static constexpr size_t BUFFER_BYTES = 1 << 20;
+
+    int fd = -1;
+    bool failed = false;
+    std::vector<char> buffer;
+    uint64_t written = 0;
+
+    void put(const void* data, size_t n);
+    void flush();
+};
+
+// Read-only memory map of a candidate file. advise() keeps a sliding window
+// around the record being read: the next window is prefetched and windows
+// more than one behind are dropped from the mapping, so streaming through
+// the file keeps about 3 * WINDOW_BYTES resident.
+class CandidateFile {
+public:
+    static constexpr size_t WINDOW_BYTES = 64 << 20;
+
+    CandidateFile() = default;
+    ~CandidateFile();
+    CandidateFile(const CandidateFile&) = delete;
+    CandidateFile& operator=(const CandidateFile&) = delete;
+
+    bool open(const std::string& path);
+    size_t mapped_bytes() const { return bytes; }
+
+    const CandidateRecordHeader& header(uint64_t offset) const {
+        return *(const CandidateRecordHeader*)(base + offset);
+    }
+    std::span<const uint32_t> tokens(uint64_t offset) const {
+        return {(const uint32_t*)(base + offset + sizeof(CandidateRecordHeader)), header(offset).length};
+    }
+    std::span<const Occurrence> occs(uint64_t offset) const {
+        const auto& h = header(offset);
+        return {(const Occurrence*)(base + offset + sizeof(CandidateRecordHeader) + h.length * sizeof(uint32_t)),
+                h.occ_count};
+    }
+    Phrase phrase(uint64_t offset) const {
+        auto t = tokens(offset);
+        auto o = occs(offset);
+        return {std::vector<uint32_t>(t.begin(), t.end()), std::vector<Occurrence>(o.begin(), o.end()),
+                header(offset).support};
+    }
+
+    // Call with non-decreasing offsets while streaming through the file.
+    void advise(uint64_t offset);
+
+private:
+    const char* base = nullptr;
+    size_t bytes = 0;
+    size_t window = SIZE_MAX;
+};
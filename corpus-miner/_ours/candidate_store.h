@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <execution>
+#include <span>
+#include <vector>
+#include "seed_record.h"
+#include "../types.h"
+
+// Columnar store of the Step 1.5 candidates. Instead of one Phrase (and two
+// heap vectors) per candidate, tokens and occurrences live in two flat arrays
+// addressed by CSR offsets, next to support and score columns:
+//
+//   tokens of i:      token_data[token_start[i] .. token_start[i + 1])
+//   occurrences of i: occ_data[occ_start[i] .. occ_start[i + 1]), sorted by (doc_id, pos)
+//
+// Each thread (or partition) fills its own store; append_all() then
+// concatenates them with one parallel copy, and Step 2 sorts an index array
+// over the columns rather than moving candidates.
+class CandidateStore {
+public:
+    CandidateStore() : token_start(1, 0), occ_start(1, 0) {}
+
+    size_t size() const { return support_.size(); }
+    bool empty() const { return support_.empty(); }
+
+    void add(std::span<const uint32_t> tokens, const SeedRecord* first, const SeedRecord* last, uint32_t support) {
+        token_data.insert(token_data.end(), tokens.begin(), tokens.end());
+        token_start.push_back(token_data.size());
+        for (const SeedRecord* r = first; r != last; ++r) occ_data.push_back({r->doc_id, r->pos});
+        occ_start.push_back(occ_data.size());
+        support_.push_back(support);
+        score_.push_back((uint64_t)support * tokens.size());
+    }
+
+    std::span<const uint32_t> tokens(size_t i) const {
+        return {token_data.data() + token_start[i], token_data.data() + token_start[i + 1]};
+    }
+    std::span<const Occurrence> occs(size_t i) const {
+        return {occ_data.data() + occ_start[i], occ_data.data() + occ_start[i + 1]};
+    }
+    uint32_t support(size_t i) const { return support_[i]; }
+    uint64_t score(size_t i) const { return score_[i]; }
+
+    Phrase phrase(size_t i) const {
+        auto t = tokens(i);
+        auto o = occs(i);
+        return {std::vector<uint32_t>(t.begin(), t.end()), std::vector<Occurrence>(o.begin(), o.end()), support(i)};
+    }
+
+    // Moves every candidate of `parts` to the end of this store, copying the
+    // parts concurrently at precomputed offsets; the parts are left empty.
+    void append_all(std::vector<CandidateStore>& parts) {
+        const size_t n = parts.size();
+        std::vector<size_t> cand_at(n + 1), token_at(n + 1), occ_at(n + 1);
+        cand_at[0] = size();
+        token_at[0] = token_data.size();
+        occ_at[0] = occ_data.size();
+        for (size_t p = 0; p < n; ++p) {
+            cand_at[p + 1] = cand_at[p] + parts[p].size();
+            token_at[p + 1] = token_at[p] + parts[p].token_data.size();
+            occ_at[p + 1] = occ_at[p] + parts[p].occ_data.size();
+        }
+        token_data.resize(token_at[n]);
+        occ_data.resize(occ_at[n]);
+        token_start.resize(cand_at[n] + 1);
+        occ_start.resize(cand_at[n] + 1);
+        support_.resize(cand_at[n]);
+        score_.resize(cand_at[n]);
+
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (size_t p = 0; p < n; ++p) {
+            CandidateStore& part = parts[p];
+            std::copy(part.token_data.begin(), part.token_data.end(), token_data.begin() + token_at[p]);
+            std::copy(part.occ_data.begin(), part.occ_data.end(), occ_data.begin() + occ_at[p]);
+            for (size_t i = 0; i < part.size(); ++i) {
+                token_start[cand_at[p] + i + 1] = token_at[p] + part.token_start[i + 1];
+                occ_start[cand_at[p] + i + 1] = occ_at[p] + part.occ_start[i + 1];
+            }
+            std::copy(part.support_.begin(), part.support_.end(), support_.begin() + cand_at[p]);
+            std::copy(part.score_.begin(), part.score_.end(), score_.begin() + cand_at[p]);
+            part = CandidateStore();
+        }
+    }
+
+    // Candidate indices by descending score, then support, then first
+    // occurrence, so the order does not depend on how candidates were built.
+    std::vector<uint32_t> order_by_score() const {
+        std::vector<uint32_t> order(size());
+        for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::sort(std::execution::par, order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            if (score_[a] != score_[b]) return score_[a] > score_[b];
+            if (support_[a] != support_[b]) return support_[a] > support_[b];
+            const Occurrence& oa = occ_data[occ_start[a]];
+            const Occurrence& ob = occ_data[occ_start[b]];
+            if (oa.doc_id != ob.doc_id) return oa.doc_id < ob.doc_id;
+            return oa.pos < ob.pos;
+        });
+        return order;
+    }
+
+    size_t memory_bytes() const {
+        return token_data.capacity() * sizeof(uint32_t) + occ_data.capacity() * sizeof(Occurrence) +
+               (token_start.capacity() + occ_start.capacity() + score_.capacity()) * sizeof(uint64_t) +
+               support_.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    std::vector<uint32_t> token_data;
+    std::vector<Occurrence> occ_data;
+    std::vector<uint64_t> token_start;
+    std::vector<uint64_t> occ_start;
+    std::vector<uint32_t> support_;
+    std::vector<uint64_t> score_;
+};
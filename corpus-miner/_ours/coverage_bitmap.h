@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Step 3 coverage mask: one bit per token of the corpus in a single flat
+// array, addressed by a global position (doc_start[doc] + pos) instead of one
+// vector<bool> per document. Ranges are set and tested a 64-bit word at a
+// time; writers use atomic fetch-or, so marks from several threads never
+// lose each other's bits, and readers use relaxed loads.
+class CoverageBitmap {
+public:
+    explicit CoverageBitmap(const std::vector<uint32_t>& doc_lengths) : doc_start(doc_lengths.size() + 1, 0) {
+        for (size_t d = 0; d < doc_lengths.size(); ++d) doc_start[d + 1] = doc_start[d] + doc_lengths[d];
+        words.assign((doc_start.back() + 63) / 64, 0);
+    }
+
+    uint64_t position(uint32_t doc, uint32_t pos) const { return doc_start[doc] + pos; }
+    uint32_t doc_length(uint32_t doc) const { return (uint32_t)(doc_start[doc + 1] - doc_start[doc]); }
+
+    bool test(uint64_t bit) const {
+        return (__atomic_load_n(&words[bit / 64], __ATOMIC_RELAXED) >> (bit % 64)) & 1;
+    }
+
+    // Sets bits [first, first + n).
+    void set_range(uint64_t first, uint64_t n) {
+        for_each_word(first, n, [&](size_t w, uint64_t mask) {
+            if ((__atomic_load_n(&words[w], __ATOMIC_RELAXED) & mask) != mask)
+                __atomic_fetch_or(&words[w], mask, __ATOMIC_RELAXED);
+        });
+    }
+
+    // True if every bit of [first, first + n) is set. Whole words in the
+    // middle of long ranges are checked four at a time with AVX2.
+    bool all_set(uint64_t first, uint64_t n) const {
+        if (n == 0) return true;
+        const uint64_t last = first + n; // exclusive
+        size_t w = first / 64;
+        const size_t w_end = (last - 1) / 64;
+        if (w == w_end) return covers(w, head_mask(first) & tail_mask(last));
+        if (!covers(w, head_mask(first))) return false;
+        ++w;
+#ifdef __AVX2__
+        const __m256i ones = _mm256_set1_epi64x(-1);
+        for (; w + 4 <= w_end; w += 4) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)&words[w]);
+            if (!_mm256_testc_si256(v, ones)) return false;
+        }
+#endif
+        for (; w < w_end; ++w)
+            if (__atomic_load_n(&words[w], __ATOMIC_RELAXED) != ~0ULL) return false;
+        return covers(w_end, tail_mask(last));
+    }
+
+    // True if any bit of [first, first + n) is set.
+    bool any_set(uint64_t first, uint64_t n) const {
+        if (n == 0) return false;
+        const uint64_t last = first + n; // exclusive
+        size_t w = first / 64;
+        const size_t w_end = (last - 1) / 64;
+        if (w == w_end) return load(w) & head_mask(first) & tail_mask(last);
+        if (load(w) & head_mask(first)) return true;
+        for (++w; w < w_end; ++w)
+            if (load(w)) return true;
+        return load(w_end) & tail_mask(last);
+    }
+
+    size_t memory_bytes() const { return words.size() * sizeof(uint64_t) + doc_start.size() * sizeof(uint64_t); }
+
+private:
+    std::vector<uint64_t> doc_start; // prefix sum of doc lengths
+    std::vector<uint64_t> words;
+
+    static uint64_t head_mask(uint64_t first) { return ~0ULL << (first % 64); }
+    static uint64_t tail_mask(uint64_t last) { return ~0ULL >> (63 - (last - 1) % 64); }
+
+    uint64_t load(size_t w) const { return __atomic_load_n(&words[w], __ATOMIC_RELAXED); }
+    bool covers(size_t w, uint64_t mask) const { return (__atomic_load_n(&words[w], __ATOMIC_RELAXED) & mask) == mask; }
+
+    template <typename F>
+    void for_each_word(uint64_t first, uint64_t n, F&& f) {
+        if (n == 0) return;
+        const uint64_t last = first + n;
+        size_t w = first / 64;
+        const size_t w_end = (last - 1) / 64;
+        if (w == w_end) {
+            f(w, head_mask(first) & tail_mask(last));
+            return;
+        }
+        f(w, head_mask(first));
+        for (++w; w < w_end; ++w) f(w, ~0ULL);
+        f(w_end, tail_mask(last));
+    }
+};
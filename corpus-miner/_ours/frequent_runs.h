@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Maximal run of consecutive frequent tokens inside one document.
+struct TokenRun {
+    uint32_t start;
+    uint32_t length;
+};
+
+// Rare-token break index. A token with word_df < min_docs can never be part
+// of a frequent n-gram, so every window covering it is hopeless. The index
+// splits each document at those tokens and keeps the runs of frequent tokens
+// that are long enough to hold at least one window.
+//
+// The per-token mask is built once per min_docs. Runs are either computed on
+// the fly with scan(), or recorded once by a first pass (record + build) and
+// looked up by later passes with runs().
+class FrequentRunIndex {
+public:
+    FrequentRunIndex(const std::vector<uint32_t>& word_df, int min_docs, int min_length)
+        : min_docs_(min_docs), min_length_(min_length), frequent(word_df.size()) {
+        const uint32_t threshold = (uint32_t)(min_docs > 0 ? min_docs : 0);
+        const uint32_t* df = word_df.data();
+        uint8_t* out = frequent.data();
+        const size_t n = word_df.size();
+        for (size_t i = 0; i < n; ++i) out[i] = (df[i] >= threshold);
+    }
+
+    int min_docs() const { return min_docs_; }
+    int min_length() const { return min_length_; }
+
+    bool is_frequent(uint32_t token) const { return frequent[token] != 0; }
+
+    // Appends the runs of `doc` to `out`. `flags` is caller-owned scratch so
+    // that the hot path does not allocate.
+    void scan(const uint32_t* doc, size_t len, std::vector<uint8_t>& flags,
+              std::vector<TokenRun>& out) const {
+        if (len < (size_t)min_length_) return;
+        flags.resize(len);
+        const uint8_t* mask = frequent.data();
+        uint8_t* f = flags.data();
+        // Plain gather loop: vectorizes with -march=native on AVX2/AVX-512.
+        for (size_t i = 0; i < len; ++i) f[i] = mask[doc[i]];
+
+        size_t i = 0;
+        while (i < len) {
+            while (i < len && f[i] == 0) ++i;
+            if (i >= len) break;
+            // memchr finds the next rare token with SIMD in libc.
+            const void* brk = std::memchr(f + i, 0, len - i);
+            size_t end = brk ? (size_t)((const uint8_t*)brk - f) : len;
+            if (end - i >= (size_t)min_length_) out.push_back({(uint32_t)i, (uint32_t)(end - i)});
+            i = end;
+        }
+    }
+
+    // Runs recorded by one thread during a pass, tagged with their document.
+    struct DocRun {
+        uint32_t doc_id;
+        TokenRun run;
+    };
+
+    // Turns the per-thread records of a full pass into per-document CSR.
+    void build(std::vector<std::vector<DocRun>>& per_thread, size_t num_docs) {
+        run_offsets.assign(num_docs + 1, 0);
+        for (const auto& part : per_thread)
+            for (const auto& r : part) run_offsets[r.doc_id + 1]++;
+        for (size_t d = 0; d < num_docs; ++d) run_offsets[d + 1] += run_offsets[d];
+
+        all_runs.resize(run_offsets[num_docs]);
+        std::vector<uint64_t> cursor(run_offsets.begin(), run_offsets.end() - 1);
+        // Runs of one document come from one thread in position order, so a
+        // plain scatter keeps them sorted.
+        for (auto& part : per_thread) {
+            for (const auto& r : part) all_runs[cursor[r.doc_id]++] = r.run;
+            part.clear();
+            part.shrink_to_fit();
+        }
+    }
+
+    bool has_runs() const { return !run_offsets.empty(); }
+
+    const TokenRun* runs_begin(uint32_t doc_id) const { return all_runs.data() + run_offsets[doc_id]; }
+    const TokenRun* runs_end(uint32_t doc_id) const { return all_runs.data() + run_offsets[doc_id + 1]; }
+
+    size_t memory_bytes() const {
+        return frequent.capacity() + run_offsets.capacity() * sizeof(uint64_t) +
+               all_runs.capacity() * sizeof(TokenRun);
+    }
+
+private:
+    int min_docs_;
+    int min_length_;
+    std::vector<uint8_t> frequent;
+    std::vector<uint64_t> run_offsets;
+    std::vector<TokenRun> all_runs;
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// Spill and candidate files hold the only copy of what they store: a failed
+// open, a short read or a short write would drop seeds or candidates
+// without a trace, so it ends the run instead. Temporary files are left in
+// place for inspection. Safe to call from inside a parallel region.
+[[noreturn]] inline void fatal_io_error(const std::string& what) {
+    std::cout << std::flush;
+    std::cerr << "\n[ERROR] " << what << "; aborting" << std::endl;
+    std::_Exit(EXIT_FAILURE);
+}
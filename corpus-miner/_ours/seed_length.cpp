@@ -0,0 +1,73 @@
+#include "seed_length.h"
+#include "bloom_filter.h"
+#include "frequent_runs.h"
+#include "seed_sort.h"
+#include "../memory_accountant.h"
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+SeedLengthChoice choose_seed_length(const CorpusMiner& corpus, int min_docs, double fraction,
+                                    size_t budget_bytes, size_t bytes_per_seed, int min_n, int max_n) {
+    SeedLengthChoice choice{max_n, false, 1.0, {}};
+    const auto& doc_lengths = corpus.get_doc_lengths();
+    const auto& word_df = corpus.get_word_df();
+
+    fraction = std::min(std::max(fraction, 2.0 / std::max(min_docs, 1)), 1.0);
+    const uint32_t stride = std::max<uint32_t>(1, (uint32_t)std::lround(1.0 / fraction));
+    choice.fraction = 1.0 / stride;
+    std::vector<uint32_t> sample;
+    for (uint32_t d = 0; d < (uint32_t)doc_lengths.size(); d += stride) sample.push_back(d);
+    const size_t threshold = std::max<size_t>(1, (size_t)std::ceil(min_docs * choice.fraction));
+
+    const int num_threads = omp_get_max_threads();
+    std::vector<std::vector<SeedRecord>> thread_seeds(num_threads);
+    std::vector<SeedRecord> seeds;
+    MemoryReservation reservation(MemComponent::SeedBuffers);
+
+    for (int n = min_n; n <= max_n; ++n) {
+        // The same rare-token runs Step 1 seeds from: windows covering a
+        // token below min_docs can never be seeds.
+        const FrequentRunIndex run_index(word_df, min_docs, n);
+        #pragma omp parallel num_threads(num_threads)
+        {
+            auto& out = thread_seeds[omp_get_thread_num()];
+            std::vector<uint8_t> flags;
+            std::vector<TokenRun> runs;
+            #pragma omp for schedule(dynamic, 64)
+            for (size_t i = 0; i < sample.size(); ++i) {
+                auto doc = corpus.doc_view(sample[i]);
+                runs.clear();
+                run_index.scan(doc.data(), doc.size(), flags, runs);
+                for (const TokenRun& r : runs)
+                    for (uint32_t p = r.start; p + n <= r.start + r.length; ++p)
+                        out.push_back({hash_tokens(doc.data() + p, n), sample[i], p});
+            }
+        }
+        seeds.clear();
+        for (auto& t : thread_seeds) {
+            seeds.insert(seeds.end(), t.begin(), t.end());
+            t.clear();
+        }
+        reservation.resize(2 * seeds.capacity() * sizeof(SeedRecord));
+        parallel_radix_sort_seeds(seeds);
+
+        SeedLengthEstimate e{n, seeds.size(), 0, 0, 0};
+        for (size_t a = 0; a < seeds.size();) {
+            size_t b = a + 1, docs = 1;
+            for (; b < seeds.size() && seeds[b].hash == seeds[a].hash; ++b)
+                if (seeds[b].doc_id != seeds[b - 1].doc_id) ++docs;
+            if (docs >= threshold) e.sample_seeds += b - a;
+            a = b;
+        }
+        e.projected_seeds = (size_t)(e.sample_seeds / choice.fraction);
+        e.projected_bytes = e.projected_seeds * bytes_per_seed;
+        choice.estimates.push_back(e);
+        if (e.projected_bytes <= budget_bytes) {
+            choice.ngrams = n;
+            choice.fits = true;
+            break;
+        }
+    }
+    return choice;
+}
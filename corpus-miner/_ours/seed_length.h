@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "../corpus_miner.h"
+
+// Sampled pre-pass of --ngrams auto. A sample of the documents (every k-th
+// one) is seeded for n = min_n, min_n + 1, ...: its n-gram windows that
+// cover no token below min_docs are grouped by hash, and an n-gram seen in
+// at least min_docs * fraction sampled documents survives. Its windows,
+// scaled by 1 / fraction, are the seeds Step 1 would gather for that n.
+
+struct SeedLengthEstimate {
+    int ngrams;
+    size_t sample_windows;  // eligible windows in the sample
+    size_t sample_seeds;    // windows of surviving n-grams in the sample
+    size_t projected_seeds; // sample_seeds scaled to the corpus
+    size_t projected_bytes; // projected_seeds * bytes_per_seed
+};
+
+struct SeedLengthChoice {
+    int ngrams;      // smallest n that fits, or max_n if none does
+    bool fits;
+    double fraction; // of the documents that were sampled
+    std::vector<SeedLengthEstimate> estimates; // every n tried, in order
+};
+
+// The fraction is raised to 2 / min_docs (capped at 1), so a surviving
+// n-gram is seen in at least two sampled documents; with a lower threshold
+// the sample could not tell frequent n-grams from singletons.
+SeedLengthChoice choose_seed_length(const CorpusMiner& corpus, int min_docs, double fraction,
+                                    size_t budget_bytes, size_t bytes_per_seed, int min_n, int max_n);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <tuple>
+
+// One n-gram occurrence found in Step 1. The tokens are not copied: they live
+// in the corpus at (doc_id, pos), and the 64-bit n-gram hash stands in for
+// them until Step 1.5 verifies a group against the corpus.
+struct SeedRecord {
+    uint64_t hash;
+    uint32_t doc_id;
+    uint32_t pos;
+
+    bool operator<(const SeedRecord& other) const {
+        return std::tie(hash, doc_id, pos) < std::tie(other.hash, other.doc_id, other.pos);
+    }
+    bool operator>(const SeedRecord& other) const { return other < *this; }
+};
+
+static_assert(sizeof(SeedRecord) == 16, "SeedRecord must stay a 16-byte record");
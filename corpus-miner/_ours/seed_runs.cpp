@@ -0,0 +1,352 @@
+#include "seed_runs.h"
+#include "io_error.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <omp.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t PAGE = 4096;
+
+bool write_all(int fd, const char* data, size_t bytes) {
+    while (bytes > 0) {
+        ssize_t w = ::write(fd, data, bytes);
+        if (w <= 0) return false;
+        data += w;
+        bytes -= (size_t)w;
+    }
+    return true;
+}
+
+inline void put_varint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+inline uint64_t get_varint(const uint8_t*& p) {
+    uint64_t v = 0;
+    int shift = 0;
+    while (*p & 0x80) {
+        v |= (uint64_t)(*p++ & 0x7F) << shift;
+        shift += 7;
+    }
+    v |= (uint64_t)(*p++) << shift;
+    return v;
+}
+
+// File descriptors the seed spills may hold at once: RLIMIT_NOFILE less
+// some for everything else (at least 3).
+size_t usable_fds() {
+    constexpr size_t RESERVED_FDS = 64;
+    size_t fd_limit = 1024;
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY) fd_limit = (size_t)rl.rlim_cur;
+    return fd_limit > RESERVED_FDS + 3 ? fd_limit - RESERVED_FDS : 3;
+}
+
+} // namespace
+
+SeedRunWriter::SeedRunWriter(const std::string& path) {
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) fatal_io_error("Could not create run file " + path);
+    pending.reserve(SEED_RUN_BLOCK_RECORDS);
+}
+
+SeedRunWriter::~SeedRunWriter() { close(); }
+
+void SeedRunWriter::append(const SeedRecord& r) {
+    pending.push_back(r);
+    if (pending.size() == SEED_RUN_BLOCK_RECORDS) flush_block();
+}
+
+void encode_seed_blocks(const SeedRecord* data, size_t n, std::vector<uint8_t>& out) {
+    for (size_t first = 0; first < n; first += SEED_RUN_BLOCK_RECORDS) {
+        size_t count = std::min(n - first, SEED_RUN_BLOCK_RECORDS);
+        size_t header_at = out.size();
+        out.resize(header_at + 8); // header, filled below
+        SeedRecord prev{0, 0, 0};
+        for (size_t i = first; i < first + count; ++i) {
+            const SeedRecord& r = data[i];
+            uint64_t hash_delta = r.hash - prev.hash;
+            put_varint(out, hash_delta);
+            if (hash_delta == 0 && i != first) {
+                uint32_t doc_delta = r.doc_id - prev.doc_id;
+                put_varint(out, doc_delta);
+                put_varint(out, doc_delta == 0 ? r.pos - prev.pos : r.pos);
+            } else {
+                put_varint(out, r.doc_id);
+                put_varint(out, r.pos);
+            }
+            prev = r;
+        }
+        uint32_t header[2] = {(uint32_t)count, (uint32_t)(out.size() - header_at - 8)};
+        std::memcpy(out.data() + header_at, header, sizeof(header));
+    }
+}
+
+void SeedRunWriter::flush_block() {
+    if (pending.empty()) return;
+    encoded.clear();
+    encode_seed_blocks(pending.data(), pending.size(), encoded);
+    if (fd >= 0 && !write_all(fd, (const char*)encoded.data(), encoded.size())) failed = true;
+    total_records += pending.size();
+    total_bytes += encoded.size();
+    pending.clear();
+}
+
+bool SeedRunWriter::close() {
+    if (fd < 0) return false;
+    flush_block();
+    ::close(fd);
+    fd = -1;
+    return !failed;
+}
+
+size_t write_seed_run(const std::string& path, const SeedRecord* data, size_t n) {
+    SeedRunWriter out(path);
+    for (size_t i = 0; i < n; ++i) out.append(data[i]);
+    if (!out.close()) fatal_io_error("Short write to run file " + path);
+    return out.bytes();
+}
+
+void read_seed_run(const std::string& path, std::vector<SeedRecord>& out) {
+    SeedRunReader in(path);
+    while (!in.done()) {
+        out.push_back(in.current());
+        in.advance();
+    }
+}
+
+SeedRunReader::SeedRunReader(const std::string& path, size_t read_bytes) {
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) fatal_io_error("Could not open run file " + path);
+    this->path = path;
+#ifdef __linux__
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    in_capacity = (read_bytes + PAGE - 1) / PAGE * PAGE;
+    in = (uint8_t*)std::aligned_alloc(PAGE, in_capacity);
+    refill();
+}
+
+SeedRunReader::~SeedRunReader() {
+    if (fd >= 0) ::close(fd);
+    std::free(in);
+}
+
+// Copies up to n bytes of the file to dst, refilling the aligned input
+// buffer with large reads as needed; returns the bytes copied, fewer than n
+// only at the end of the file.
+size_t SeedRunReader::read_bytes(uint8_t* dst, size_t n) {
+    size_t copied = 0;
+    while (copied < n) {
+        if (in_pos == in_len) {
+            if (file_eof) break;
+            in_pos = 0;
+            in_len = 0;
+            while (in_len < in_capacity) {
+                ssize_t r = ::read(fd, in + in_len, in_capacity - in_len);
+                if (r < 0 && errno == EINTR) continue;
+                if (r < 0) fatal_io_error("Read error on run file " + path);
+                if (r == 0) {
+                    file_eof = true;
+                    break;
+                }
+                in_len += (size_t)r;
+            }
+            if (in_len == 0) break;
+        }
+        size_t take = std::min(n - copied, in_len - in_pos);
+        std::memcpy(dst + copied, in + in_pos, take);
+        in_pos += take;
+        copied += take;
+    }
+    return copied;
+}
+
+void SeedRunReader::refill() {
+    pos = 0;
+    block.clear();
+    if (eof) return;
+    uint32_t header[2];
+    size_t got = read_bytes((uint8_t*)header, sizeof(header));
+    if (got == 0) {
+        eof = true;
+        return;
+    }
+    payload.resize(header[1]);
+    if (got < sizeof(header) || read_bytes(payload.data(), payload.size()) < payload.size())
+        fatal_io_error("Truncated seed run block in " + path);
+
+    block.resize(header[0]);
+    const uint8_t* p = payload.data();
+    SeedRecord prev{0, 0, 0};
+    for (uint32_t i = 0; i < header[0]; ++i) {
+        SeedRecord r;
+        uint64_t hash_delta = get_varint(p);
+        r.hash = prev.hash + hash_delta;
+        if (hash_delta == 0 && i > 0) {
+            uint32_t doc_delta = (uint32_t)get_varint(p);
+            r.doc_id = prev.doc_id + doc_delta;
+            uint32_t pos_code = (uint32_t)get_varint(p);
+            r.pos = doc_delta == 0 ? prev.pos + pos_code : pos_code;
+        } else {
+            r.doc_id = (uint32_t)get_varint(p);
+            r.pos = (uint32_t)get_varint(p);
+        }
+        block[i] = r;
+        prev = r;
+    }
+}
+
+bool SeedRunReader::advance() {
+    if (++pos < block.size()) return true;
+    refill();
+    return !block.empty();
+}
+
+SeedLoserTree::SeedLoserTree(std::vector<std::unique_ptr<SeedRunReader>> runs)
+    : readers(std::move(runs)), k((int)readers.size()) {
+    if (k == 0) return;
+    tree.assign(k, -1);
+    winner = build(1);
+    if (readers[winner]->done()) winner = -1;
+}
+
+bool SeedLoserTree::before(int a, int b) const {
+    bool a_done = readers[a]->done();
+    bool b_done = readers[b]->done();
+    if (a_done || b_done) return !a_done;
+    const SeedRecord& x = readers[a]->current();
+    const SeedRecord& y = readers[b]->current();
+    if (x.hash != y.hash) return x.hash < y.hash;
+    if (x.doc_id != y.doc_id) return x.doc_id < y.doc_id;
+    return x.pos < y.pos;
+}
+
+// Leaves are the runs, numbered k..2k-1 in heap order; returns the winner of
+// the subtree at `node` and stores the loser of its root match in tree[node].
+int SeedLoserTree::build(int node) {
+    if (node >= k) return node - k;
+    int left = build(2 * node);
+    int right = build(2 * node + 1);
+    if (before(left, right)) {
+        tree[node] = right;
+        return left;
+    }
+    tree[node] = left;
+    return right;
+}
+
+void SeedLoserTree::pop() {
+    int w = winner;
+    readers[w]->advance();
+    // Replay the matches on the path from the winner's leaf to the root.
+    for (int node = (w + k) / 2; node >= 1; node /= 2) {
+        if (before(tree[node], w)) std::swap(tree[node], w);
+    }
+    winner = readers[w]->done() ? -1 : w;
+}
+
+SeedRunMerger::SeedRunMerger(std::vector<std::string> runs, const std::string& temp_dir, size_t fan_in) {
+    // Every concurrent group holds fan_in readers and one writer, so the
+    // open files stay within usable_fds().
+    const size_t fds = usable_fds();
+    fan_in = std::clamp<size_t>(fan_in, 2, fds - 1);
+    effective_fan_in = fan_in;
+    const int parallel_groups = (int)std::max<size_t>(1, fds / (fan_in + 1));
+
+    // Cascade: merge groups of fan_in runs into longer runs until one final
+    // merge can take all of them at once.
+    while (runs.size() > fan_in) {
+        size_t groups = (runs.size() + fan_in - 1) / fan_in;
+        std::vector<std::string> next(groups);
+        std::cout << "[LOG] Step 1.5: Merge pass " << merge_passes << ": " << runs.size()
+                  << " runs -> " << groups << std::endl;
+
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(std::min(omp_get_max_threads(), parallel_groups))
+        for (size_t g = 0; g < groups; ++g) {
+            std::vector<std::unique_ptr<SeedRunReader>> group;
+            size_t first = g * fan_in;
+            size_t last = std::min(runs.size(), first + fan_in);
+            for (size_t i = first; i < last; ++i) group.push_back(std::make_unique<SeedRunReader>(runs[i]));
+            SeedLoserTree merge(std::move(group));
+
+            next[g] = temp_dir + "/merge_" + std::to_string(merge_passes) + "_" + std::to_string(g) + ".bin";
+            SeedRunWriter out(next[g]);
+            while (!merge.empty()) {
+                out.append(merge.top());
+                merge.pop();
+            }
+            // The inputs are only removed once their merge is safely written.
+            if (!out.close()) fatal_io_error("Short write to run file " + next[g]);
+            for (size_t i = first; i < last; ++i) fs::remove(runs[i]);
+        }
+        runs.swap(next);
+        merge_passes++;
+    }
+
+    std::vector<std::unique_ptr<SeedRunReader>> readers;
+    for (const auto& path : runs) readers.push_back(std::make_unique<SeedRunReader>(path));
+    tree = std::make_unique<SeedLoserTree>(std::move(readers));
+}
+
+// Every partition file stays open while seeds are spilled, so the count is
+// capped by usable_fds() like the merge fan-in.
+SeedPartitionWriter::SeedPartitionWriter(const std::string& temp_dir, size_t partitions)
+    : files(std::clamp<size_t>(partitions, 1, usable_fds())), fds(files.size(), -1), counts(files.size(), 0),
+      locks(new std::mutex[files.size()]) {
+    if (files.size() < partitions)
+        std::cout << "[WARNING] " << partitions << " seed partitions exceed the open file limit; using "
+                  << files.size() << std::endl;
+    for (size_t p = 0; p < files.size(); ++p) {
+        files[p] = temp_dir + "/part_" + std::to_string(p) + ".bin";
+        fds[p] = ::open(files[p].c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fds[p] < 0) fatal_io_error("Could not create partition file " + files[p]);
+    }
+}
+
+SeedPartitionWriter::~SeedPartitionWriter() { close(); }
+
+size_t SeedPartitionWriter::append(const SeedRecord* data, size_t n) {
+    std::vector<uint8_t> encoded;
+    size_t total = 0;
+    size_t first = 0;
+    while (first < n) {
+        size_t p = partition_of(data[first].hash);
+        size_t last = first + 1;
+        while (last < n && partition_of(data[last].hash) == p) ++last;
+
+        // Encode outside the lock; only the write itself is serialized.
+        encoded.clear();
+        encode_seed_blocks(data + first, last - first, encoded);
+        {
+            std::lock_guard<std::mutex> lock(locks[p]);
+            if (fds[p] < 0 || !write_all(fds[p], (const char*)encoded.data(), encoded.size())) failed = true;
+            counts[p] += last - first;
+        }
+        total += encoded.size();
+        first = last;
+    }
+    return total;
+}
+
+bool SeedPartitionWriter::close() {
+    for (int& fd : fds) {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+    return !failed;
+}
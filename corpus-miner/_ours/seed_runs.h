@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "seed_record.h"
+
+// Spill runs of the external seed sort: sorted SeedRecord files in
+// miner_tmp/, written by Step 1 and merged by Step 1.5.
+//
+// Run format: a sequence of independent blocks of up to SEED_RUN_BLOCK_RECORDS
+// records, each `uint32 count, uint32 payload_bytes, payload`. Inside a
+// block, records are delta-coded against their predecessor with LEB128
+// varints, exploiting the sort order:
+//   hash delta; then, if the hash repeats, doc_id delta and, if the doc
+//   repeats too, pos delta; otherwise absolute doc_id and pos.
+// Seeds of one n-gram therefore cost a few bytes each, and the first
+// record of a block is coded against zero.
+
+constexpr size_t SEED_RUN_BLOCK_RECORDS = 64 * 1024;
+
+// Buffered, block-encoding writer of one sorted run.
+class SeedRunWriter {
+public:
+    explicit SeedRunWriter(const std::string& path);
+    ~SeedRunWriter();
+    SeedRunWriter(const SeedRunWriter&) = delete;
+    SeedRunWriter& operator=(const SeedRunWriter&) = delete;
+
+    bool ok() const { return fd >= 0 && !failed; }
+    void append(const SeedRecord& r);
+    // Flushes the last block; returns false on any write error.
+    bool close();
+
+    size_t records() const { return total_records; }
+    size_t bytes() const { return total_bytes; }
+
+private:
+    int fd = -1;
+    bool failed = false;
+    std::vector<SeedRecord> pending;
+    std::vector<uint8_t> encoded;
+    size_t total_records = 0;
+    size_t total_bytes = 0;
+
+    void flush_block();
+};
+
+// Appends data[0, n) to `out` as encoded blocks.
+void encode_seed_blocks(const SeedRecord* data, size_t n, std::vector<uint8_t>& out);
+
+// Writes a sorted run in one go; returns the encoded size in bytes.
+size_t write_seed_run(const std::string& path, const SeedRecord* data, size_t n);
+
+// Appends every record of a run file to `out`.
+void read_seed_run(const std::string& path, std::vector<SeedRecord>& out);
+
+// Block-buffered sequential reader of one run. Reads go straight to read(2)
+// in large page-aligned chunks, with sequential read-ahead advised to the
+// kernel, and are decoded one block at a time. A file that cannot be
+// opened or read, or ends inside a block, is a fatal error.
+class SeedRunReader {
+public:
+    static constexpr size_t DEFAULT_READ_BYTES = 512 * 1024;
+
+    explicit SeedRunReader(const std::string& path, size_t read_bytes = DEFAULT_READ_BYTES);
+    ~SeedRunReader();
+    SeedRunReader(const SeedRunReader&) = delete;
+    SeedRunReader& operator=(const SeedRunReader&) = delete;
+
+    bool done() const { return pos == block.size() && eof; }
+    const SeedRecord& current() const { return block[pos]; }
+    // Moves to the next record; returns false at the end of the run.
+    bool advance();
+
+private:
+    int fd = -1;
+    std::string path;
+    uint8_t* in = nullptr;     // raw bytes from the file
+    size_t in_capacity = 0;
+    size_t in_len = 0;
+    size_t in_pos = 0;
+    bool file_eof = false;
+
+    std::vector<uint8_t> payload;
+    std::vector<SeedRecord> block; // decoded records of the current block
+    size_t pos = 0;
+    bool eof = false;
+
+    size_t read_bytes(uint8_t* dst, size_t n);
+    void refill();
+};
+
+// Tournament (loser) tree over k runs: replacing the winner costs exactly
+// ceil(log2 k) comparisons along one leaf-to-root path.
+class SeedLoserTree {
+public:
+    explicit SeedLoserTree(std::vector<std::unique_ptr<SeedRunReader>> runs);
+
+    bool empty() const { return winner < 0; }
+    const SeedRecord& top() const { return readers[winner]->current(); }
+    void pop();
+
+private:
+    std::vector<std::unique_ptr<SeedRunReader>> readers;
+    std::vector<int> tree; // tree[1..k-1] hold losers of internal matches
+    int k = 0;
+    int winner = -1;
+
+    // True if run a should come out before run b; exhausted runs lose.
+    bool before(int a, int b) const;
+    int build(int node);
+};
+
+// K-way merge of all spill runs. When there are more runs than `fan_in`,
+// intermediate passes merge groups of `fan_in` runs into new runs (in
+// parallel across groups) until a single final pass is left, so the number
+// of open files and concurrent seeks stays bounded: fan_in and the number of
+// groups merged at once are capped by RLIMIT_NOFILE. A run's inputs are
+// deleted only after its output has been written in full.
+class SeedRunMerger {
+public:
+    SeedRunMerger(std::vector<std::string> runs, const std::string& temp_dir, size_t fan_in);
+
+    bool empty() const { return tree->empty(); }
+    const SeedRecord& top() const { return tree->top(); }
+    void pop() { tree->pop(); }
+
+    int passes() const { return merge_passes; }
+    size_t fan_in() const { return effective_fan_in; }
+
+private:
+    std::unique_ptr<SeedLoserTree> tree;
+    int merge_passes = 1;
+    size_t effective_fan_in = 0;
+};
+
+// Hash-partitioned spill files for --seed-mode partition. Partition p holds
+// the seeds whose hash falls in the p-th of P equal slices of the hash range,
+// so every n-gram lands in exactly one partition and partitions can be
+// grouped independently. A partition file is a concatenation of sorted
+// fragments in the run format above (it is not sorted as a whole).
+class SeedPartitionWriter {
+public:
+    SeedPartitionWriter(const std::string& temp_dir, size_t partitions);
+    ~SeedPartitionWriter();
+    SeedPartitionWriter(const SeedPartitionWriter&) = delete;
+    SeedPartitionWriter& operator=(const SeedPartitionWriter&) = delete;
+
+    size_t partitions() const { return files.size(); }
+    // Monotone in the hash: a hash-sorted buffer splits into contiguous slices.
+    size_t partition_of(uint64_t hash) const { return (size_t)(((hash >> 32) * files.size()) >> 32); }
+
+    // Writes a hash-sorted buffer as one fragment per partition it touches.
+    // Thread-safe; returns the encoded bytes written.
+    size_t append(const SeedRecord* data, size_t n);
+    // Closes every file; returns false if any write failed.
+    bool close();
+
+    const std::string& path(size_t p) const { return files[p]; }
+    size_t records(size_t p) const { return counts[p]; }
+
+private:
+    std::vector<std::string> files;
+    std::vector<int> fds;
+    std::vector<size_t> counts;
+    std::unique_ptr<std::mutex[]> locks;
+    std::atomic<bool> failed{false};
+};
@@ -0,0 +1,169 @@
+#include "seed_sort.h"
+#include <algorithm>
+#include <cstring>
+#include <omp.h>
+
+namespace {
+
+// Digit d of the 128-bit key (hash:doc_id:pos), least significant first.
+// 0-3 are the bytes of pos, 4-7 of doc_id, 8-15 of hash.
+constexpr int KEY_DIGITS = 16;
+constexpr int HASH_DIGITS_BEGIN = 8;
+constexpr size_t SMALL_SORT = 256;
+// Buckets up to this many records (~1 MB) are finished with LSD passes in
+// cache; larger ones are split again on their next hash byte first.
+constexpr size_t CACHE_RESIDENT = 1u << 16;
+
+inline unsigned digit(const SeedRecord& r, int d) {
+    if (d < 4) return (r.pos >> (8 * d)) & 0xFF;
+    if (d < 8) return (r.doc_id >> (8 * (d - 4))) & 0xFF;
+    return (unsigned)(r.hash >> (8 * (d - 8))) & 0xFF;
+}
+
+bool doc_pos_sorted(const SeedRecord* data, size_t n) {
+    for (size_t i = 1; i < n; ++i) {
+        if (data[i].doc_id < data[i - 1].doc_id) return false;
+        if (data[i].doc_id == data[i - 1].doc_id && data[i].pos < data[i - 1].pos) return false;
+    }
+    return true;
+}
+
+// Stable counting scatter of src into dst on digit d, with the digit
+// extraction specialised per field so the inner loop has no branches.
+void scatter(const SeedRecord* src, SeedRecord* dst, size_t n, int d, size_t* offsets) {
+    if (d < 4) {
+        const int s = 8 * d;
+        for (size_t i = 0; i < n; ++i) dst[offsets[(src[i].pos >> s) & 0xFF]++] = src[i];
+    } else if (d < 8) {
+        const int s = 8 * (d - 4);
+        for (size_t i = 0; i < n; ++i) dst[offsets[(src[i].doc_id >> s) & 0xFF]++] = src[i];
+    } else {
+        const int s = 8 * (d - 8);
+        for (size_t i = 0; i < n; ++i) dst[offsets[(src[i].hash >> s) & 0xFF]++] = src[i];
+    }
+}
+
+// LSD over digits [first, last) of data[0, n); the result ends up in data.
+void lsd_sort(SeedRecord* data, SeedRecord* scratch, size_t n, int first, int last) {
+    if (n < SMALL_SORT) {
+        std::sort(data, data + n);
+        return;
+    }
+    if (doc_pos_sorted(data, n)) first = std::max(first, HASH_DIGITS_BEGIN);
+
+    // One read pass fills the histograms of every digit.
+    size_t hist[KEY_DIGITS][256];
+    std::memset(hist, 0, sizeof(hist));
+    for (size_t i = 0; i < n; ++i) {
+        const SeedRecord& r = data[i];
+        uint64_t h = r.hash;
+        for (int b = 0; b < 4; ++b) hist[b][(r.pos >> (8 * b)) & 0xFF]++;
+        for (int b = 0; b < 4; ++b) hist[4 + b][(r.doc_id >> (8 * b)) & 0xFF]++;
+        for (int b = 0; b < 8; ++b) hist[8 + b][(h >> (8 * b)) & 0xFF]++;
+    }
+
+    SeedRecord* src = data;
+    SeedRecord* dst = scratch;
+    for (int d = first; d < last; ++d) {
+        if (hist[d][digit(src[0], d)] == n) continue; // constant digit
+        size_t offsets[256];
+        size_t sum = 0;
+        for (int b = 0; b < 256; ++b) {
+            offsets[b] = sum;
+            sum += hist[d][b];
+        }
+        scatter(src, dst, n, d, offsets);
+        std::swap(src, dst);
+    }
+    if (src != data) std::memcpy(data, src, n * sizeof(SeedRecord));
+}
+
+// Sorts data[0, n) on digits [0, last): splits on digit last-1 (a hash byte)
+// while the range is larger than the cache, then finishes with LSD.
+void hybrid_sort(SeedRecord* data, SeedRecord* scratch, size_t n, int last) {
+    if (n <= CACHE_RESIDENT || last <= HASH_DIGITS_BEGIN) {
+        lsd_sort(data, scratch, n, 0, last);
+        return;
+    }
+    const int d = last - 1;
+    size_t counts[256] = {};
+    for (size_t i = 0; i < n; ++i) counts[digit(data[i], d)]++;
+    size_t offsets[256], starts[257];
+    size_t sum = 0;
+    for (int b = 0; b < 256; ++b) {
+        starts[b] = offsets[b] = sum;
+        sum += counts[b];
+    }
+    starts[256] = sum;
+    scatter(data, scratch, n, d, offsets);
+    std::memcpy(data, scratch, n * sizeof(SeedRecord));
+    for (int b = 0; b < 256; ++b) {
+        size_t len = starts[b + 1] - starts[b];
+        if (len > 1) hybrid_sort(data + starts[b], scratch + starts[b], len, d);
+    }
+}
+
+} // namespace
+
+void radix_sort_seeds(SeedRecord* data, size_t n, std::vector<SeedRecord>& scratch) {
+    if (n < 2) return;
+    if (scratch.size() < n) scratch.resize(n);
+    hybrid_sort(data, scratch.data(), n, KEY_DIGITS);
+}
+
+void parallel_radix_sort_seeds(std::vector<SeedRecord>& seeds) {
+    const size_t n = seeds.size();
+    const int threads = omp_get_max_threads();
+    if (threads <= 1 || n < CACHE_RESIDENT) {
+        std::vector<SeedRecord> scratch;
+        radix_sort_seeds(seeds.data(), n, scratch);
+        return;
+    }
+
+    // Stable MSD scatter on the top hash byte: every thread histograms and
+    // then scatters its own contiguous block. The team may be smaller than
+    // requested (OMP_DYNAMIC, thread limits, nesting), so the blocks are cut
+    // by the size it actually got.
+    std::vector<SeedRecord> out(n);
+    std::vector<size_t> counts((size_t)threads * 256, 0);
+    std::vector<size_t> bucket_start(257, 0);
+    int team = 1;
+
+    #pragma omp parallel num_threads(threads)
+    {
+        #pragma omp single
+        team = omp_get_num_threads();
+
+        const int t = omp_get_thread_num();
+        const size_t begin = n * t / team;
+        const size_t end = n * (t + 1) / team;
+        size_t* my = &counts[(size_t)t * 256];
+        for (size_t i = begin; i < end; ++i) my[seeds[i].hash >> 56]++;
+
+        #pragma omp barrier
+        #pragma omp single
+        {
+            size_t sum = 0;
+            for (int b = 0; b < 256; ++b) {
+                bucket_start[b] = sum;
+                for (int tt = 0; tt < team; ++tt) {
+                    size_t c = counts[(size_t)tt * 256 + b];
+                    counts[(size_t)tt * 256 + b] = sum;
+                    sum += c;
+                }
+            }
+            bucket_start[256] = sum;
+        }
+
+        for (size_t i = begin; i < end; ++i) out[my[seeds[i].hash >> 56]++] = seeds[i];
+    }
+
+    // Buckets are independent: finish each on the remaining 15 digits, using
+    // the (now free) input array as scratch.
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+    for (int b = 0; b < 256; ++b) {
+        size_t len = bucket_start[b + 1] - bucket_start[b];
+        if (len > 1) hybrid_sort(out.data() + bucket_start[b], seeds.data() + bucket_start[b], len, KEY_DIGITS - 1);
+    }
+    seeds.swap(out);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "seed_record.h"
+
+// Radix sorts for SeedRecord by (hash, doc_id, pos), replacing comparator
+// sorts in Step 1 and in the in-memory path of Step 1.5.
+//
+// The key is 16 bytes wide. Large inputs are first split MSD-style on hash
+// bytes until each bucket fits in cache; buckets are then finished with 8-bit
+// LSD passes. All digit histograms of a bucket are built in one read pass,
+// and digits that are constant across it are skipped (in practice the high
+// bytes of doc_id and pos).
+// When the input is already ordered by (doc_id, pos) -- a thread's seed buffer
+// always is -- only the hash bytes are sorted, since LSD passes are stable.
+
+// Single-threaded; safe to call from inside a parallel region. `scratch` is
+// resized to n and reused across calls.
+void radix_sort_seeds(SeedRecord* data, size_t n, std::vector<SeedRecord>& scratch);
+
+// Parallel: a stable MSD scatter on the top hash byte, then the 256 buckets
+// are finished independently with radix_sort_seeds on the remaining digits.
+void parallel_radix_sort_seeds(std::vector<SeedRecord>& seeds);
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Lock-free open-addressing table of the n-grams that pass the Bloom filter,
+// for --seed-mode hash. An n-gram is keyed by its 64-bit hash; its tokens are
+// not copied but referenced through the occurrences gathered next to the
+// table, and Step 1.5 verifies them against the corpus exactly as it does for
+// sorted seeds. Each slot keeps the exact number of distinct documents seen
+// for its key, so only frequent keys need their occurrences grouped, and its
+// occurrence count, so they can be bucketed in a single scatter pass.
+//
+// insert() never blocks: linear probing with one CAS to claim an empty slot.
+// The table does not grow; insert() reports "full" once the load limit is
+// reached and the caller falls back to sorting.
+class SeedHashTable {
+public:
+    static constexpr uint32_t FULL = UINT32_MAX;
+
+    // Occurrence of a table key, appended to a per-thread chunk in Step 1.
+    struct Occurrence {
+        uint32_t slot;
+        uint32_t doc_id;
+        uint32_t pos;
+    };
+
+    static size_t capacity_for(size_t expected_keys) {
+        size_t capacity = 1024;
+        while (capacity < 2 * expected_keys) capacity <<= 1;
+        return capacity;
+    }
+    static size_t bytes_for(size_t expected_keys) { return capacity_for(expected_keys) * sizeof(Slot); }
+
+    explicit SeedHashTable(size_t expected_keys)
+        : capacity_(capacity_for(expected_keys)), mask(capacity_ - 1),
+          max_used(capacity_ / 4 * 3), slots(new Slot[capacity_]) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            slots[i].key.store(0, std::memory_order_relaxed);
+            slots[i].docs.store(0, std::memory_order_relaxed);
+            slots[i].occurrences.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    size_t capacity() const { return capacity_; }
+    size_t used() const { return used_.load(std::memory_order_relaxed); }
+    size_t memory_bytes() const { return capacity_ * sizeof(Slot); }
+
+    // Issues the cache miss of a later insert(hash) early; callers prefetch a
+    // document's keys in a batch before inserting them.
+    void prefetch(uint64_t hash) const { __builtin_prefetch(&slots[home(hash ? hash : 1)], 1); }
+
+    // Slot of `hash`, claiming an empty one if needed; FULL past the load limit.
+    uint32_t insert(uint64_t hash) {
+        const uint64_t key = hash ? hash : 1; // 0 marks empty slots
+        size_t i = home(key);
+        for (;;) {
+            uint64_t current = slots[i].key.load(std::memory_order_relaxed);
+            if (current == key) return (uint32_t)i;
+            if (current == 0) {
+                if (used_.load(std::memory_order_relaxed) >= max_used) return FULL;
+                if (slots[i].key.compare_exchange_strong(current, key, std::memory_order_relaxed)) {
+                    used_.fetch_add(1, std::memory_order_relaxed);
+                    return (uint32_t)i;
+                }
+                if (current == key) return (uint32_t)i;
+            }
+            i = (i + 1) & mask;
+        }
+    }
+
+    // Called once per (key, document) with the key's occurrences in it;
+    // callers dedupe within a document.
+    void add_doc(uint32_t slot, uint32_t occurrences) {
+        slots[slot].docs.fetch_add(1, std::memory_order_relaxed);
+        slots[slot].occurrences.fetch_add(occurrences, std::memory_order_relaxed);
+    }
+
+    uint64_t hash(uint32_t slot) const { return slots[slot].key.load(std::memory_order_relaxed); }
+    uint32_t docs(uint32_t slot) const { return slots[slot].docs.load(std::memory_order_relaxed); }
+    uint32_t occurrences(uint32_t slot) const { return slots[slot].occurrences.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> key;
+        std::atomic<uint32_t> docs;
+        std::atomic<uint32_t> occurrences;
+    };
+
+    size_t home(uint64_t key) const { return (key * 0x9E3779B97F4A7C15ULL) >> 32 & mask; }
+
+    size_t capacity_;
+    size_t mask;
+    size_t max_used;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<size_t> used_{0};
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Space-Saving heavy-hitter summary (Metwally et al.) over n-gram hashes, for
+// --seed-mode topk. It monitors at most `capacity` keys; a key that is not
+// monitored replaces the one with the smallest count and inherits that count
+// as its error. For every monitored key
+//
+//   count - error <= true count <= count,   error <= offered() / capacity,
+//
+// and every key whose true count exceeds offered() / capacity is monitored.
+// Summaries built by different threads are combined with merge(), which keeps
+// the same guarantees over the union of their streams (Agarwal et al.,
+// "Mergeable Summaries").
+class SpaceSavingSummary {
+public:
+    struct Entry {
+        uint64_t key;
+        uint32_t count;
+        uint32_t error;
+    };
+
+    explicit SpaceSavingSummary(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)) {
+        heap.reserve(capacity_);
+        where.reserve(capacity_);
+    }
+
+    size_t capacity() const { return capacity_; }
+    size_t size() const { return heap.size(); }
+    // Total count offered so far (the N of the error bound).
+    size_t offered() const { return total; }
+    // Count a key that is not monitored may have had: 0 until the summary fills.
+    uint32_t min_count() const { return heap.size() < capacity_ ? 0 : heap[0].count; }
+
+    void offer(uint64_t key) {
+        total++;
+        auto it = where.find(key);
+        if (it != where.end()) {
+            heap[it->second].count++;
+            sift_down(it->second);
+        } else if (heap.size() < capacity_) {
+            heap.push_back({key, 1, 0});
+            where[key] = heap.size() - 1;
+            sift_up(heap.size() - 1);
+        } else {
+            where.erase(heap[0].key);
+            uint32_t floor = heap[0].count;
+            heap[0] = {key, floor + 1, floor};
+            where[key] = 0;
+            sift_down(0);
+        }
+    }
+
+    // Folds `other` into this summary. A key missing from one side is
+    // charged that side's min_count() both as count and as error, so counts
+    // stay upper bounds; the `capacity` largest merged counts are kept.
+    void merge(const SpaceSavingSummary& other) {
+        const uint32_t own_min = min_count();
+        const uint32_t other_min = other.min_count();
+        struct Merged {
+            Entry entry;
+            bool in_other;
+        };
+        std::unordered_map<uint64_t, Merged> merged;
+        merged.reserve(heap.size() + other.heap.size());
+        for (const auto& e : heap) merged[e.key] = {e, false};
+        for (const auto& e : other.heap) {
+            auto it = merged.find(e.key);
+            if (it != merged.end()) {
+                it->second.entry.count += e.count;
+                it->second.entry.error += e.error;
+                it->second.in_other = true;
+            } else {
+                merged[e.key] = {{e.key, e.count + own_min, e.error + own_min}, true};
+            }
+        }
+
+        heap.clear();
+        for (auto& [key, m] : merged) {
+            if (!m.in_other) {
+                m.entry.count += other_min;
+                m.entry.error += other_min;
+            }
+            heap.push_back(m.entry);
+        }
+        if (heap.size() > capacity_) {
+            std::nth_element(heap.begin(), heap.begin() + capacity_, heap.end(), by_count_desc);
+            heap.resize(capacity_);
+        }
+        std::make_heap(heap.begin(), heap.end(), by_count_desc);
+        where.clear();
+        for (size_t i = 0; i < heap.size(); ++i) where[heap[i].key] = i;
+        total += other.total;
+    }
+
+    // The k monitored keys with the largest counts, largest first.
+    std::vector<Entry> top(size_t k) const {
+        std::vector<Entry> out(heap);
+        std::sort(out.begin(), out.end(), [](const Entry& a, const Entry& b) {
+            if (a.count != b.count) return a.count > b.count;
+            return a.key < b.key;
+        });
+        if (out.size() > k) out.resize(k);
+        return out;
+    }
+
+    static size_t bytes_for(size_t capacity) {
+        // Heap entry plus an unordered_map node and bucket.
+        return capacity * (sizeof(Entry) + 4 * sizeof(void*));
+    }
+
+private:
+    size_t capacity_;
+    size_t total = 0;
+    std::vector<Entry> heap; // min-heap on count
+    std::unordered_map<uint64_t, size_t> where;
+
+    // std heap helpers build a max-heap, so "less" is reversed.
+    static bool by_count_desc(const Entry& a, const Entry& b) { return a.count > b.count; }
+
+    void swap_entries(size_t a, size_t b) {
+        std::swap(heap[a], heap[b]);
+        where[heap[a].key] = a;
+        where[heap[b].key] = b;
+    }
+    void sift_up(size_t i) {
+        while (i > 0 && heap[i].count < heap[(i - 1) / 2].count) {
+            swap_entries(i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+    }
+    void sift_down(size_t i) {
+        for (;;) {
+            size_t smallest = i;
+            size_t l = 2 * i + 1, r = l + 1;
+            if (l < heap.size() && heap[l].count < heap[smallest].count) smallest = l;
+            if (r < heap.size() && heap[r].count < heap[smallest].count) smallest = r;
+            if (smallest == i) return;
+            swap_entries(i, smallest);
+            i = smallest;
+        }
+    }
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+// Distinct-document support of an occurrence list (anything with a doc_id
+// member). Every list the miner builds is ordered by doc_id: seeds are sorted
+// by (hash, doc_id, pos), and extending a phrase only filters its
+// occurrences. A document is therefore counted where doc_id changes, which is
+// exact, needs no memory and touches each occurrence once, so giant groups
+// do not need a hash set (or a cardinality sketch) to be counted.
+
+template <typename T>
+size_t count_distinct_docs(const T* first, const T* last) {
+    size_t n = 0;
+    for (const T* r = first; r != last; ++r)
+        if (r == first || r->doc_id != (r - 1)->doc_id) ++n;
+    return n;
+}
+
+// Threshold decision: stops as soon as `min_docs` documents are seen, and
+// rejects lists with fewer occurrences than that without reading them.
+template <typename T>
+bool has_min_docs(const T* first, const T* last, size_t min_docs) {
+    if ((size_t)(last - first) < min_docs) return false;
+    size_t n = 0;
+    for (const T* r = first; r != last; ++r)
+        if ((r == first || r->doc_id != (r - 1)->doc_id) && ++n >= min_docs) return true;
+    return n >= min_docs;
+}
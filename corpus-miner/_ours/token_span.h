@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Length of the common prefix of token spans a[0, n) and b[0, n), comparing
+// eight tokens per step with AVX2 when available.
+inline size_t common_prefix_length(const uint32_t* a, const uint32_t* b, size_t n) {
+    size_t i = 0;
+#ifdef __AVX2__
+    for (; i + 8 <= n; i += 8) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+        unsigned equal = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(va, vb)));
+        if (equal != 0xFF) return i + __builtin_ctz(~equal);
+    }
+#endif
+    while (i < n && a[i] == b[i]) ++i;
+    return i;
+}
+
+// Length of the common suffix of the spans ending just before a_end and
+// b_end, compared backwards for at most n tokens.
+inline size_t common_suffix_length(const uint32_t* a_end, const uint32_t* b_end, size_t n) {
+    size_t i = 0;
+#ifdef __AVX2__
+    for (; i + 8 <= n; i += 8) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a_end - i - 8));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b_end - i - 8));
+        unsigned equal = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(va, vb)));
+        // Lane 7 is the token nearest the end; the last mismatching lane is
+        // the first mismatch going backwards.
+        if (equal != 0xFF) return i + 7 - (31 - __builtin_clz(~equal & 0xFF));
+    }
+#endif
+    while (i < n && a_end[-1 - (ptrdiff_t)i] == b_end[-1 - (ptrdiff_t)i]) ++i;
+    return i;
+}
@@ -0,0 +1,64 @@
+// Seed sort benchmark (make bench-seed-sort): comparator std::sort against
+// the radix sorts of _ours/seed_sort.h on synthetic SeedRecords.
+//
+//   seed_sort_bench [seeds] [case]
+//
+// `seeds` records (default 100M, 1.6 GB) draw their hash from seeds / 20
+// distinct values; doc_id and pos advance in order (300 positions per doc),
+// as in a thread's Step 1 buffer. "shuffled" inputs are permuted first.
+// Without `case`, all four cases run one after another.
+#include "../_ours/seed_sort.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <execution>
+#include <random>
+#include <vector>
+
+static std::vector<SeedRecord> make_seeds(size_t n, bool shuffle) {
+    std::mt19937_64 rng(42);
+    std::vector<uint64_t> pool(n / 20 + 1);
+    for (auto& h : pool) h = rng();
+    std::vector<SeedRecord> seeds(n);
+    uint32_t doc = 0, pos = 0;
+    for (size_t i = 0; i < n; ++i) {
+        seeds[i] = {pool[rng() % pool.size()], doc, pos};
+        if (++pos == 300) {
+            pos = 0;
+            ++doc;
+        }
+    }
+    if (shuffle) std::shuffle(seeds.begin(), seeds.end(), rng);
+    return seeds;
+}
+
+template <typename Sort>
+static void run(const char* name, size_t n, bool shuffle, Sort sort) {
+    auto seeds = make_seeds(n, shuffle);
+    auto start = std::chrono::steady_clock::now();
+    sort(seeds);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%-45s %8.2f s%s\n", name, seconds, std::is_sorted(seeds.begin(), seeds.end()) ? "" : "  NOT SORTED");
+}
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000000ULL;
+    int only = argc > 2 ? std::atoi(argv[2]) : -1;
+    std::printf("%zu seeds, %zu distinct hashes\n", n, n / 20 + 1);
+
+    if (only < 0 || only == 0)
+        run("std::sort(par) comparator, shuffled", n, true,
+            [](auto& v) { std::sort(std::execution::par, v.begin(), v.end()); });
+    if (only < 0 || only == 1)
+        run("std::sort(par) comparator, doc-ordered", n, false,
+            [](auto& v) { std::sort(std::execution::par, v.begin(), v.end()); });
+    if (only < 0 || only == 2)
+        run("parallel_radix_sort_seeds, shuffled", n, true, [](auto& v) { parallel_radix_sort_seeds(v); });
+    if (only < 0 || only == 3) {
+        std::vector<SeedRecord> scratch;
+        run("radix_sort_seeds, doc-ordered", n, false,
+            [&](auto& v) { radix_sort_seeds(v.data(), v.size(), scratch); });
+    }
+    return 0;
+}
@@ -2,11 +2,11 @@
 #include "tokenizer.h"
 #include "timer.h"
 #include "signal_handler.h"
+#include "_ours/io_error.h"
 #include <iostream>
 #include <fstream>
 #include <unistd.h>
 #include <filesystem>
-#include <unordered_set>
 #include <unordered_map>
 #include <algorithm>
 #include <thread>
@@ -19,9 +19,8 @@
 #include <cstring>
 #include <vector>
 #include <cstdio>
-#ifdef __APPLE__
-#include <mach/mach.h>
-#endif
+#include <sys/mman.h>
+#include <fcntl.h>
 
 namespace fs = std::filesystem;
 
@@ -230,10 +229,13 @@ const std::vector<uint32_t>& CorpusMiner::fetch_doc(uint32_t doc_id) const {
     auto it = doc_cache.find(doc_id);
     if (it != doc_cache.end()) return it->second;
 
-    // 2. Manage Cache Size (Simple FIFO/Random eviction)
-    if (doc_cache.size() >= max_cache_size) {
+    // 2. Manage Cache Size (Simple FIFO/Random eviction), by entry count and
+    // by the memory budget.
+    auto evict_one = [&]() {
+        memory_accountant().release(MemComponent::DocCache, cached_doc_bytes(doc_cache.begin()->second));
         doc_cache.erase(doc_cache.begin());
-    }
+    };
+    if (doc_cache.size() >= max_cache_size) evict_one();
 
     // 3. Read from Disk
     std::vector<uint32_t> doc(doc_lengths[doc_id]);
@@ -241,6 +243,14 @@ const std::vector<uint32_t>& CorpusMiner::fetch_doc(uint32_t doc_id) const {
     bin_in.seekg(doc_offsets[doc_id]);
     bin_in.read((char*)doc.data(), doc_lengths[doc_id] * sizeof(uint32_t));
 
+    const size_t bytes = cached_doc_bytes(doc);
+    while (!memory_accountant().try_reserve(MemComponent::DocCache, bytes)) {
+        if (doc_cache.empty()) {
+            memory_accountant().reserve(MemComponent::DocCache, bytes);
+            break;
+        }
+        evict_one();
+    }
     return doc_cache[doc_id] = std::move(doc);
 }
 
@@ -333,6 +343,13 @@ void CorpusMiner::load_csv(const std::string& path, char delimiter, double sampl
         bin_out = std::make_unique<std::ofstream>(bin_corpus_path, std::ios::binary);
     }
 
+    if (sketch_ngrams > 0) {
+        size_t total_windows = 0;
+        for (const auto& raw : raw_docs)
+            if (raw.size() >= (size_t)sketch_ngrams) total_windows += raw.size() - sketch_ngrams + 1;
+        init_ngram_sketch(total_windows);
+    }
+
     for (size_t i = 0; i < n; ++i) {
         file_paths.push_back("row_" + std::to_string(i));
         std::vector<uint32_t> encoded;
@@ -359,6 +376,7 @@ void CorpusMiner::load_csv(const std::string& path, char delimiter, double sampl
         }
 
         doc_lengths.push_back(encoded.size());
+        add_to_ngram_sketch(encoded);
 
         if (in_memory_only) {
             docs.push_back(std::move(encoded));
@@ -370,6 +388,11 @@ void CorpusMiner::load_csv(const std::string& path, char delimiter, double sampl
         }
         raw_docs[i].clear();
     }
+    if (bin_out) {
+        bin_out->close();
+        map_corpus();
+    }
+    account_corpus();
     stop_timer("CSV Loading & Encoding", total_start);
 }
 
@@ -463,6 +486,13 @@ void CorpusMiner::load_directory(const std::string& path, double sampling) {
         bin_out = std::make_unique<std::ofstream>(bin_corpus_path, std::ios::binary);
     }
 
+    if (sketch_ngrams > 0) {
+        size_t total_windows = 0;
+        for (const auto& raw : raw_docs)
+            if (raw.size() >= (size_t)sketch_ngrams) total_windows += raw.size() - sketch_ngrams + 1;
+        init_ngram_sketch(total_windows);
+    }
+
     for (size_t i = 0; i < n; ++i) {
             file_paths.push_back(paths[i].string());
             std::vector<uint32_t> encoded;
@@ -489,6 +519,7 @@ void CorpusMiner::load_directory(const std::string& path, double sampling) {
             }
 
             doc_lengths.push_back(encoded.size());
+            add_to_ngram_sketch(encoded);
 
             if (in_memory_only) {
                 docs.push_back(std::move(encoded));
@@ -497,7 +528,8 @@ void CorpusMiner::load_directory(const std::string& path, double sampling) {
                 bin_out->write((char*)encoded.data(), encoded.size() * sizeof(uint32_t));
 
                 // If preload is requested, keep in cache while building
-                if (preload_cache && doc_cache.size() < max_cache_size) {
+                if (preload_cache && doc_cache.size() < max_cache_size &&
+                    memory_accountant().try_reserve(MemComponent::DocCache, cached_doc_bytes(encoded))) {
                     doc_cache[i] = encoded; // Copy before clearing
                 }
                 encoded.clear();
@@ -506,30 +538,101 @@ void CorpusMiner::load_directory(const std::string& path, double sampling) {
         }
     word_last_doc_id.clear();
     word_last_doc_id.shrink_to_fit();
+    if (bin_out) {
+        bin_out->close();
+        map_corpus();
+    }
+    account_corpus();
     stop_timer("Dictionary, Encoding & DF counting", p2_start);
     stop_timer("Total Loading", total_start);
 }
 
-size_t CorpusMiner::get_current_rss_mb() {
-#ifdef __APPLE__
-    struct mach_task_basic_info info;
-    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
-    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) == KERN_SUCCESS) {
-        return info.resident_size / (1024 * 1024);
-    }
-    return 0;
-#else
-    std::ifstream stat_stream("/proc/self/statm", std::ios_base::in);
-    unsigned long long pages;
-    if (!(stat_stream >> pages >> pages)) return 0;
-    return (pages * sysconf(_SC_PAGESIZE)) / (1024 * 1024);
-#endif
+CorpusMiner::~CorpusMiner() {
+    if (mapped_corpus) munmap((void*)mapped_corpus, mapped_bytes);
+}
+
+void CorpusMiner::map_corpus() {
+    if (mapped_corpus) {
+        munmap((void*)mapped_corpus, mapped_bytes);
+        mapped_corpus = nullptr;
+    }
+    // doc_view() spans point into the mapping; there is no safe fallback,
+    // since doc cache entries can be evicted while a view is held.
+    int fd = open(bin_corpus_path.c_str(), O_RDONLY);
+    if (fd < 0) fatal_io_error("Could not open " + bin_corpus_path + " for mapping");
+    size_t bytes = (size_t)lseek(fd, 0, SEEK_END);
+    if (bytes > 0) {
+        void* addr = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) fatal_io_error("mmap of " + bin_corpus_path + " failed");
+        mapped_corpus = (const uint32_t*)addr;
+        mapped_bytes = bytes;
+    }
+    close(fd);
+}
+
+void CorpusMiner::prefetch_docs(std::vector<uint32_t>& doc_ids) const {
+    if (in_memory_only || !mapped_corpus || doc_ids.empty()) return;
+    // doc_offsets grow with doc_id, so id order is file order.
+    std::sort(doc_ids.begin(), doc_ids.end());
+    doc_ids.erase(std::unique(doc_ids.begin(), doc_ids.end()), doc_ids.end());
+
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t budget = PREFETCH_BYTES;
+    size_t run_begin = 0, run_end = 0;
+    auto issue = [&]() {
+        size_t first = run_begin / page * page;
+        size_t n = std::min(run_end - first, budget);
+        madvise((void*)((const char*)mapped_corpus + first), n, MADV_WILLNEED);
+        budget -= n;
+    };
+    for (uint32_t doc_id : doc_ids) {
+        size_t begin = doc_offsets[doc_id];
+        size_t end = begin + doc_lengths[doc_id] * sizeof(uint32_t);
+        if (begin == end) continue;
+        if (run_end > 0 && begin <= run_end + PREFETCH_GAP) {
+            run_end = std::max(run_end, end);
+            continue;
+        }
+        if (run_end > 0) issue();
+        if (budget == 0) return;
+        run_begin = begin;
+        run_end = end;
+    }
+    if (run_end > 0 && budget > 0) issue();
+}
+
+void CorpusMiner::init_ngram_sketch(size_t total_windows) {
+    int threshold = std::min(sketch_min_docs, 255);
+    size_t size = CountingBloomFilter::choose_size(total_windows, threshold, sketch_fp,
+                                                   sketch_mb, memory_limit_mb, sketch_capped);
+    std::cout << "[LOG] Phase II: Counting " << sketch_ngrams << "-grams into a "
+              << (size / (1024 * 1024)) << " MB Bloom sketch (" << total_windows << " windows)"
+              << (sketch_capped ? " [capped by --mem]" : "") << std::endl;
+    ngram_sketch = std::make_unique<CountingBloomFilter>(size);
+}
+
+void CorpusMiner::add_to_ngram_sketch(const std::vector<uint32_t>& encoded) {
+    if (!ngram_sketch || encoded.size() < (size_t)sketch_ngrams) return;
+    for (size_t p = 0; p + sketch_ngrams <= encoded.size(); ++p) {
+        ngram_sketch->add(hash_tokens(encoded.data() + p, sketch_ngrams));
+    }
+}
+
+void CorpusMiner::account_corpus() {
+    size_t bytes = doc_offsets.capacity() * sizeof(size_t) + doc_lengths.capacity() * sizeof(uint32_t) +
+                   word_df.capacity() * sizeof(uint32_t);
+    for (const auto& doc : docs) bytes += doc.capacity() * sizeof(uint32_t) + sizeof(doc);
+    // Each dictionary word lives twice (id_to_word and the word_to_id key),
+    // plus hash node overhead.
+    for (const auto& w : id_to_word) bytes += 2 * (sizeof(std::string) + w.capacity()) + 32;
+    corpus_reservation.resize(bytes);
 }
 
 void CorpusMiner::save_to_csv(const std::vector<Phrase>& res, const std::string& out_p) {
     std::ofstream f(out_p);
     if (!f.is_open()) return;
     std::cout << "[LOG] Saving to " << out_p << std::endl;
+
     f << "phrase,freq,length,example_files\n";
     for (const auto& p : res) {
         f << "\"";
@@ -541,22 +644,18 @@ void CorpusMiner::save_to_csv(const std::vector<Phrase>& res, const std::string&
         }
         f << "\"," << p.support << "," << p.tokens.size() << ",\"";
 
-        std::unordered_set<uint32_t> d_ids;
-        for (auto& o : p.occs) d_ids.insert(o.doc_id);
-
+        // The first two distinct documents are the examples; no need to
+        // collect every document of a phrase that may occur millions of times.
+        uint32_t examples[2];
         size_t count = 0;
-        if (d_ids.empty()) {
-            f << "\"\n"; // Если это результат SPMF без позиций
-        } else {
-            for (auto id : d_ids) {
-            if (id < file_paths.size()) {
-                    f << file_paths[id];
-                    if (++count >= 2) break; // Limit to 2 examples
-                    if (count < d_ids.size()) f << "|";
-                }
-            }
-            f << "\"\n";
+        for (const auto& o : p.occs) {
+            if (count > 0 && o.doc_id == examples[0]) continue;
+            if (o.doc_id >= file_paths.size()) continue;
+            examples[count++] = o.doc_id;
+            if (count == 2) break; // Limit to 2 examples
         }
+        for (size_t i = 0; i < count; ++i) f << (i ? "|" : "") << file_paths[examples[i]];
+        f << "\"\n"; // empty for SPMF results, which carry no positions
     }
 }
 
@@ -6,7 +6,11 @@
 #include <string>
 #include <unordered_map>
 #include <mutex>
+#include <memory>
+#include <span>
 #include "types.h"
+#include "memory_accountant.h"
+#include "_ours/bloom_filter.h"
 
 // Forward declaration for algorithms
 class IMiningAlgorithm;
@@ -26,7 +30,9 @@ private:
 
     std::string file_mask = "";
 
-    size_t get_current_rss_mb();
+    // Loaded corpus (docs, offsets, lengths, dictionary) against --mem.
+    MemoryReservation corpus_reservation{MemComponent::Corpus};
+    void account_corpus();
 
     std::string bin_corpus_path = "corpus_data.bin";
     std::vector<size_t> doc_offsets;
@@ -40,12 +46,36 @@ private:
     size_t max_cache_size = 1000;
 
     const std::vector<uint32_t>& fetch_doc(uint32_t doc_id) const;
+    static size_t cached_doc_bytes(const std::vector<uint32_t>& doc) {
+        return doc.size() * sizeof(uint32_t) + 64; // plus node overhead
+    }
+
+    // Read-only mapping of corpus_data.bin (disk mode), set up after loading.
+    const uint32_t* mapped_corpus = nullptr;
+    size_t mapped_bytes = 0;
+    void map_corpus();
+
+    // Optional n-gram sketch filled while encoding (Phase II), so that the
+    // Bloom miner does not need a separate frequency pass over the corpus.
+    int sketch_ngrams = 0;
+    int sketch_min_docs = 0;
+    size_t sketch_mb = 0;
+    double sketch_fp = 0.01;
+    bool sketch_capped = false;
+    std::unique_ptr<CountingBloomFilter> ngram_sketch;
+
+    void init_ngram_sketch(size_t total_windows);
+    void add_to_ngram_sketch(const std::vector<uint32_t>& encoded);
 
     void export_to_spmf(const std::string& path) const;
     void import_from_spmf(const std::string& spmf_out, const std::string& final_csv, int min_l);
 
 
 public:
+    CorpusMiner() = default;
+    ~CorpusMiner();
+    CorpusMiner(const CorpusMiner&) = delete;
+    CorpusMiner& operator=(const CorpusMiner&) = delete;
 
     void run_spmf(const std::string& algo,
               const std::string& spmf_params,
@@ -65,6 +95,21 @@ public:
         min_tokens = min_l;
     }
 
+    void enable_ngram_sketch(int ngrams, int min_docs, size_t bloom_mb, double bloom_fp) {
+        sketch_ngrams   = ngrams;
+        sketch_min_docs = min_docs;
+        sketch_mb       = bloom_mb;
+        sketch_fp       = bloom_fp;
+    }
+
+    // Hands the loader-built sketch over to the caller if it counted
+    // `ngrams`-grams; returns nullptr otherwise or when already taken.
+    std::unique_ptr<CountingBloomFilter> take_ngram_sketch(int ngrams) {
+        if (ngrams != sketch_ngrams) return nullptr;
+        return std::move(ngram_sketch);
+    }
+    bool is_ngram_sketch_capped() const { return sketch_capped; }
+
     int get_max_threads() const { return max_threads; }
     size_t get_memory_limit_mb() const { return memory_limit_mb; }
     bool is_in_memory_only() const { return in_memory_only; }
@@ -76,6 +121,26 @@ public:
         return fetch_doc(doc_id);
     }
 
+    // Zero-copy, thread-safe view of a document: the in-memory vector, or the
+    // mapped binary corpus in disk mode. Unlike get_doc() it is never evicted;
+    // map_corpus() aborts rather than leave disk mode without a mapping (only
+    // an all-empty corpus has none, and its views are empty).
+    std::span<const uint32_t> doc_view(uint32_t doc_id) const {
+        if (in_memory_only) return {docs[doc_id].data(), docs[doc_id].size()};
+        if (!mapped_corpus) return {};
+        return {mapped_corpus + doc_offsets[doc_id] / sizeof(uint32_t), doc_lengths[doc_id]};
+    }
+
+    // Disk mode: reads the given documents of the mapped corpus ahead of use
+    // (sorts and dedups `doc_ids`). Documents are visited in file order and
+    // ranges less than PREFETCH_GAP apart are coalesced, so a batch of
+    // scattered documents becomes a few large sequential reads instead of a
+    // page fault per document. At most PREFETCH_BYTES are requested per
+    // call; a no-op unless the corpus is mapped.
+    static constexpr size_t PREFETCH_GAP = 128 << 10;
+    static constexpr size_t PREFETCH_BYTES = 256 << 20;
+    void prefetch_docs(std::vector<uint32_t>& doc_ids) const;
+
     const std::vector<uint32_t>& get_doc_lengths() const { return doc_lengths; }
     const std::vector<size_t>& get_doc_offsets() const { return doc_offsets; }
 
@@ -1,8 +1,10 @@
 #include "corpus_miner.h"
 #include "signal_handler.h"
 #include "algorithm_factory.h"
+#include <algorithm>
 #include <filesystem>
 #include <iostream>
+#include <sstream>
 #include <csignal>
 
 namespace fs = std::filesystem;
@@ -14,10 +16,23 @@ int main(int argc, char** argv) {
         std::cout << "Usage: ./corpus_miner <dir-or-csv> [options]\n"
                   << "Options:\n"
                   << "  --n <int>        Min documents (default: 10)\n"
-                  << "  --ngrams <int>   N-gram size (default: 4)\n"
+                  << "  --ngrams <int|auto> N-gram size; auto picks it from a sampled pre-pass (default: 4)\n"
                   << "  --mem <int>      Memory limit in MB (0 for no limit)\n"
                   << "  --threads <int>  Max CPU threads (0 for all)\n"
                   << "  --algo <name>    Mining algorithm (default: bloom)\n"
+                  << "  --bloom-mb <int> Bloom filter size in MB (default: auto)\n"
+                  << "  --bloom-fp <f>   Target Bloom false-positive rate (default: 0.01)\n"
+                  << "  --fused-bloom    Count n-grams into the Bloom filter while loading\n"
+                  << "  --merge-fan-in <int> Max spill runs merged at once (default: 64)\n"
+                  << "  --seed-mode <auto|sort|partition|hash|topk> Seed backend (default: auto)\n"
+                  << "  --seed-partitions <int> Partitions for --seed-mode partition (default: auto)\n"
+                  << "  --top-k <int>    N-grams seeded by --seed-mode topk (default: 1000)\n"
+                  << "  --candidates-on-disk Keep Step 1.5 candidates in an on-disk store\n"
+                  << "  --expansion-batch <int> Candidates expanded concurrently in Step 3 (default: auto, 1 = serial)\n"
+                  << "  --split-step <int>      Occurrences above which one Step 3 step uses all threads (default: 65536, 0 = off)\n"
+                  << "  --rescore        Expand Step 3 candidates from a heap rescored on uncovered occurrences\n"
+                  << "  --ngram-cascade <list> Seed lengths mined longest first over uncovered text, e.g. 8,5,3\n"
+                  << "  --auto-sample <float> Fraction of documents sampled by --ngrams auto (default: 0.05)\n"
                   << std::endl;
         return 1;
     }
@@ -39,6 +54,21 @@ int main(int argc, char** argv) {
     std::string spmf_jar = "./spmf.jar";
 
     std::string algo_name = "bloomspan";   // NEW default
+    int bloom_mb = 0;
+    double bloom_fp = 0.01;
+    bool fused_bloom = false;
+    int merge_fan_in = 64;
+    std::string seed_mode = "auto";
+    int seed_partitions = 0;
+    int top_k = 1000;
+    bool candidates_on_disk = false;
+    int expansion_batch = 0;
+    bool expansion_batch_set = false;
+    int split_step_occs = 65536;
+    bool rescore_candidates = false;
+    std::vector<int> ngram_cascade;
+    bool auto_ngrams = false;
+    double auto_sample = 0.05;
 
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
@@ -47,7 +77,12 @@ int main(int argc, char** argv) {
         else if (arg == "--spmf-params" && i + 1 < argc) spmf_params = argv[++i];
         else if (arg == "--spmf-jar-location" && i + 1 < argc) spmf_jar = argv[++i];
         else if (arg == "--mask" && i + 1 < argc) mask = argv[++i];
-        else if (arg == "--ngrams" && i + 1 < argc) ngrams = std::stoi(argv[++i]);
+        else if (arg == "--ngrams" && i + 1 < argc) {
+            std::string n = argv[++i];
+            if (n == "auto") auto_ngrams = true;
+            else ngrams = std::stoi(n);
+        }
+        else if (arg == "--auto-sample" && i + 1 < argc) auto_sample = std::stod(argv[++i]);
         else if (arg == "--min_l" && i + 1 < argc) min_l = std::stoi(argv[++i]);
         else if (arg == "--csv-delimiter" && i + 1 < argc) {
             std::string delim = argv[++i];
@@ -62,16 +97,101 @@ int main(int argc, char** argv) {
         else if (arg == "--in-mem") in_mem = true;
         else if (arg == "--preload") preload = true;
         else if (arg == "--algo" && i + 1 < argc) algo_name = argv[++i];   // NEW
+        else if (arg == "--bloom-mb" && i + 1 < argc) bloom_mb = std::stoi(argv[++i]);
+        else if (arg == "--bloom-fp" && i + 1 < argc) bloom_fp = std::stod(argv[++i]);
+        else if (arg == "--fused-bloom") fused_bloom = true;
+        else if (arg == "--merge-fan-in" && i + 1 < argc) merge_fan_in = std::stoi(argv[++i]);
+        else if (arg == "--seed-mode" && i + 1 < argc) seed_mode = argv[++i];
+        else if (arg == "--seed-partitions" && i + 1 < argc) seed_partitions = std::stoi(argv[++i]);
+        else if (arg == "--top-k" && i + 1 < argc) top_k = std::stoi(argv[++i]);
+        else if (arg == "--candidates-on-disk") candidates_on_disk = true;
+        else if (arg == "--expansion-batch" && i + 1 < argc) {
+            expansion_batch = std::stoi(argv[++i]);
+            expansion_batch_set = true;
+        }
+        else if (arg == "--split-step" && i + 1 < argc) split_step_occs = std::stoi(argv[++i]);
+        else if (arg == "--rescore") rescore_candidates = true;
+        else if (arg == "--ngram-cascade" && i + 1 < argc) {
+            std::stringstream lengths(argv[++i]);
+            for (std::string n; std::getline(lengths, n, ',');)
+                if (!n.empty()) ngram_cascade.push_back(std::stoi(n));
+        }
     }
 
-    if (min_l == 0) min_l = ngrams;
+    const std::vector<std::string> seed_modes = {"auto", "sort", "partition", "hash", "topk"};
+    if (std::find(seed_modes.begin(), seed_modes.end(), seed_mode) == seed_modes.end()) {
+        std::cerr << "[ERROR] Unknown --seed-mode '" << seed_mode
+                  << "' (expected auto, sort, partition, hash or topk)" << std::endl;
+        return 1;
+    }
+    // --expansion-batch defaults to auto (0 internally); an explicit value
+    // must name a batch size.
+    if (expansion_batch_set && expansion_batch < 1) {
+        std::cerr << "[ERROR] --expansion-batch must be at least 1 (1 = serial)" << std::endl;
+        return 1;
+    }
+    // Only --ngrams auto selects the seed length; 0 is not a shorthand.
+    if (ngrams < 1) {
+        std::cerr << "[ERROR] --ngrams must be at least 1 or auto" << std::endl;
+        return 1;
+    }
+    if (!(auto_sample > 0.0 && auto_sample <= 1.0)) {
+        std::cerr << "[ERROR] --auto-sample must be in (0, 1]" << std::endl;
+        return 1;
+    }
+    if (bloom_mb < 0) {
+        std::cerr << "[ERROR] --bloom-mb must not be negative (0 = auto)" << std::endl;
+        return 1;
+    }
+    if (!(bloom_fp > 0.0 && bloom_fp < 1.0)) {
+        std::cerr << "[ERROR] --bloom-fp must be between 0 and 1 (exclusive)" << std::endl;
+        return 1;
+    }
+    if (seed_partitions < 0) {
+        std::cerr << "[ERROR] --seed-partitions must not be negative (0 = auto)" << std::endl;
+        return 1;
+    }
+    if (top_k < 0) {
+        std::cerr << "[ERROR] --top-k must not be negative" << std::endl;
+        return 1;
+    }
+    if (merge_fan_in < 2) {
+        std::cerr << "[ERROR] --merge-fan-in must be at least 2" << std::endl;
+        return 1;
+    }
+
+    // A cascade runs its seed lengths longest first; --ngrams names the
+    // first pass (the fused sketch is built for it).
+    if (!ngram_cascade.empty()) {
+        std::sort(ngram_cascade.rbegin(), ngram_cascade.rend());
+        ngram_cascade.erase(std::unique(ngram_cascade.begin(), ngram_cascade.end()), ngram_cascade.end());
+        ngram_cascade.erase(std::remove_if(ngram_cascade.begin(), ngram_cascade.end(), [](int n) { return n < 1; }),
+                            ngram_cascade.end());
+        if (!ngram_cascade.empty()) ngrams = ngram_cascade.front();
+    }
+    // --ngrams auto: the Bloom miner picks the seed length after loading
+    // (ngrams = 0 until then; a --min-l of 0 follows the choice).
+    if (auto_ngrams && (use_spmf || parse_algorithm_kind(algo_name) != AlgorithmKind::BloomNgram ||
+                        !ngram_cascade.empty())) {
+        std::cout << "[WARNING] --ngrams auto only applies to the bloom miner without --ngram-cascade; using "
+                  << ngrams << std::endl;
+        auto_ngrams = false;
+    }
+    if (auto_ngrams) ngrams = 0;
+    if (min_l == 0) min_l = ngram_cascade.empty() ? ngrams : ngram_cascade.back();
 
     std::cout << "[START] Initializing Miner..." << std::endl;
     if (in_mem) std::cout << "[MODE] Running in In-Memory mode (No Disk BIN)" << std::endl;
 
+    memory_accountant().set_limit((size_t)mem_limit * 1024 * 1024);
+
     CorpusMiner corpus;
     corpus.set_limits(threads, mem_limit, cache_size, in_mem, preload, min_l);
     corpus.set_mask(mask);
+    if (fused_bloom && auto_ngrams)
+        std::cout << "[LOG] --fused-bloom is skipped with --ngrams auto (the seed length is not known yet)" << std::endl;
+    else if (fused_bloom && !use_spmf && parse_algorithm_kind(algo_name) == AlgorithmKind::BloomNgram)
+        corpus.enable_ngram_sketch(ngrams, min_docs, bloom_mb, bloom_fp);
 
     if (fs::is_regular_file(input_path)) {
         corpus.load_csv(input_path, csv_delimiter, sampling);
@@ -89,13 +209,30 @@ if (use_spmf) {
         // Standard C++ execution
         AlgorithmKind kind = parse_algorithm_kind(algo_name);
         auto algo = make_algorithm(kind);
+        if (kind == AlgorithmKind::BloomNgram)
+            static_cast<BloomNgramMiner&>(*algo).set_ngram_sketch(corpus.take_ngram_sketch(ngrams), ngrams,
+                                                                  corpus.is_ngram_sketch_capped());
         MiningParams params{min_docs, ngrams, "results_max.csv", min_l};
+        params.bloom_mb = bloom_mb;
+        params.bloom_fp = bloom_fp;
+        params.merge_fan_in = merge_fan_in;
+        params.seed_mode = seed_mode;
+        params.seed_partitions = seed_partitions;
+        params.top_k = top_k;
+        params.candidates_on_disk = candidates_on_disk;
+        params.expansion_batch = expansion_batch;
+        params.split_step_occs = split_step_occs;
+        params.rescore_candidates = rescore_candidates;
+        params.ngram_cascade = ngram_cascade;
+        params.auto_sample = auto_sample;
         std::cout << "[START] Beginning mining with algorithm=" << algo_name
-                      << ", min_docs=" << min_docs << ", ngrams=" << ngrams << std::endl;
+                      << ", min_docs=" << min_docs << ", ngrams=" << (auto_ngrams ? "auto" : std::to_string(ngrams))
+                      << std::endl;
         std::vector<Phrase> phrases = algo->mine(corpus, params);
         corpus.save_to_csv(phrases, params.output_csv);
     }
 
+    memory_accountant().report();
     std::cout << "[DONE] Process finished." << std::endl;
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "memory_accountant.h"
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+double to_mb(size_t bytes) { return std::round(bytes / (1024.0 * 1024.0) * 10) / 10; }
+
+void raise_peak(std::atomic<size_t>& peak, size_t value) {
+    size_t current = peak.load(std::memory_order_relaxed);
+    while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+MemoryAccountant& memory_accountant() {
+    static MemoryAccountant accountant;
+    return accountant;
+}
+
+const char* MemoryAccountant::name(MemComponent c) {
+    static const char* names[(size_t)MemComponent::Count] = {
+        "corpus", "doc cache", "bloom filter", "run index",
+        "seed buffers", "seed table", "candidates", "expansion"};
+    return names[(size_t)c];
+}
+
+void MemoryAccountant::add(MemComponent c, size_t bytes) {
+    Slot& s = slot(c);
+    raise_peak(s.peak, s.used.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+bool MemoryAccountant::try_reserve(MemComponent c, size_t bytes) {
+    size_t current = total.load(std::memory_order_relaxed);
+    do {
+        if (has_limit() && current + bytes > limit_bytes) return false;
+    } while (!total.compare_exchange_weak(current, current + bytes, std::memory_order_relaxed));
+    raise_peak(total_peak, current + bytes);
+    add(c, bytes);
+    return true;
+}
+
+void MemoryAccountant::reserve(MemComponent c, size_t bytes) {
+    size_t now = total.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    raise_peak(total_peak, now);
+    if (has_limit() && now > limit_bytes) raise_peak(overshoot, now - limit_bytes);
+    add(c, bytes);
+}
+
+void MemoryAccountant::release(MemComponent c, size_t bytes) {
+    total.fetch_sub(bytes, std::memory_order_relaxed);
+    slot(c).used.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+size_t MemoryAccountant::available() const {
+    if (!has_limit()) return SIZE_MAX;
+    size_t now = used();
+    return now < limit_bytes ? limit_bytes - now : 0;
+}
+
+void MemoryAccountant::report(std::ostream& out) const {
+    out << "[MEMORY] Peak reservations:";
+    for (size_t i = 0; i < (size_t)MemComponent::Count; ++i) {
+        size_t p = slots[i].peak.load(std::memory_order_relaxed);
+        if (p > 0) out << " " << name((MemComponent)i) << "=" << to_mb(p) << " MB";
+    }
+    out << std::endl;
+    out << "[MEMORY] Peak total: " << to_mb(peak()) << " MB";
+    if (has_limit()) out << " (limit " << to_mb(limit_bytes) << " MB)";
+    out << std::endl;
+    if (overshoot.load() > 0)
+        out << "[WARNING] Required structures exceeded --mem by " << to_mb(overshoot.load()) << " MB" << std::endl;
+}
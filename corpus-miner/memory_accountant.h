@@ -0,0 +1,112 @@
+#ifndef MEMORY_ACCOUNTANT_H
+#define MEMORY_ACCOUNTANT_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+
+// Big structures whose memory counts against --mem.
+enum class MemComponent {
+    Corpus,      // encoded documents (--in-mem), offsets, lengths, dictionary
+    DocCache,    // disk-mode document cache
+    BloomFilter, // counting Bloom filter / loader sketch
+    RunIndex,    // rare-token break index
+    SeedBuffers, // Step 1 seed buffers
+    SeedTable,   // --seed-mode hash table and its occurrence chunks
+    Candidates,  // Step 1.5 candidate phrases and their occurrence lists
+    Expansion,   // Step 3 coverage state, expanded and final phrases
+    Count
+};
+
+// Process-wide accounting of reserved bytes per component, replacing RSS
+// polling. Components reserve before (or while) they allocate and release
+// when they free; try_reserve() refuses to cross the limit, which is what
+// spilling and eviction decisions are based on. reserve() always succeeds
+// for structures that cannot be shrunk and records the overshoot, so the
+// final report shows whether --mem held. All calls are thread-safe.
+class MemoryAccountant {
+public:
+    static constexpr size_t NO_LIMIT = 0;
+
+    void set_limit(size_t bytes) { limit_bytes = bytes; }
+    size_t limit() const { return limit_bytes; }
+    bool has_limit() const { return limit_bytes != NO_LIMIT; }
+
+    // Reserves `bytes` unless that would exceed the limit.
+    bool try_reserve(MemComponent c, size_t bytes);
+    void reserve(MemComponent c, size_t bytes);
+    void release(MemComponent c, size_t bytes);
+
+    size_t used() const { return total.load(std::memory_order_relaxed); }
+    size_t used(MemComponent c) const { return slot(c).used.load(std::memory_order_relaxed); }
+    size_t peak() const { return total_peak.load(std::memory_order_relaxed); }
+    size_t peak(MemComponent c) const { return slot(c).peak.load(std::memory_order_relaxed); }
+    // Bytes left under the limit (SIZE_MAX without one).
+    size_t available() const;
+
+    // Peak reservation per component and overall.
+    void report(std::ostream& out = std::cout) const;
+
+    static const char* name(MemComponent c);
+
+private:
+    struct Slot {
+        std::atomic<size_t> used{0};
+        std::atomic<size_t> peak{0};
+    };
+
+    size_t limit_bytes = NO_LIMIT;
+    std::atomic<size_t> total{0};
+    std::atomic<size_t> total_peak{0};
+    std::atomic<size_t> overshoot{0};
+    std::array<Slot, (size_t)MemComponent::Count> slots;
+
+    Slot& slot(MemComponent c) { return slots[(size_t)c]; }
+    const Slot& slot(MemComponent c) const { return slots[(size_t)c]; }
+    void add(MemComponent c, size_t bytes);
+};
+
+MemoryAccountant& memory_accountant();
+
+// Move-only RAII handle on one component's reservation; resize() adjusts it
+// to a structure's new footprint.
+class MemoryReservation {
+public:
+    explicit MemoryReservation(MemComponent c, size_t bytes = 0) : component(c) { resize(bytes); }
+    ~MemoryReservation() { resize(0); }
+    MemoryReservation(MemoryReservation&& other) noexcept : component(other.component), held(other.held) {
+        other.held = 0;
+    }
+    MemoryReservation& operator=(MemoryReservation&& other) noexcept {
+        if (this != &other) {
+            resize(0);
+            component = other.component;
+            held = other.held;
+            other.held = 0;
+        }
+        return *this;
+    }
+    MemoryReservation(const MemoryReservation&) = delete;
+    MemoryReservation& operator=(const MemoryReservation&) = delete;
+
+    void resize(size_t bytes) {
+        if (bytes > held) memory_accountant().reserve(component, bytes - held);
+        else if (bytes < held) memory_accountant().release(component, held - bytes);
+        held = bytes;
+    }
+    // Like resize(), but refuses to grow past the limit; returns false then.
+    bool try_resize(size_t bytes) {
+        if (bytes > held && !memory_accountant().try_reserve(component, bytes - held)) return false;
+        if (bytes < held) memory_accountant().release(component, held - bytes);
+        held = bytes;
+        return true;
+    }
+    size_t bytes() const { return held; }
+
+private:
+    MemComponent component;
+    size_t held = 0;
+};
+
+#endif // MEMORY_ACCOUNTANT_H
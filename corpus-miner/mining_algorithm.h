@@ -9,9 +9,54 @@ class CorpusMiner;  // forward declaration
 // Generic params for mining (extend as needed later)
 struct MiningParams {
     int min_docs;
-    int ngrams;
+    int ngrams; // 0 = auto: the miner picks it from a sampled pre-pass
     std::string output_csv;
     int min_l;
+
+    // Bloom filter sizing: explicit size in MB, or 0 to size it from the
+    // corpus n-gram count so that the singleton FP rate stays below bloom_fp.
+    size_t bloom_mb = 0;
+    double bloom_fp = 0.01;
+
+    // Maximum number of spill runs merged at once in Step 1.5; more runs
+    // are merged in cascaded passes.
+    size_t merge_fan_in = 64;
+
+    // Seed backend of Steps 1/1.5: "sort" spills sorted runs (without
+    // --in-mem) and k-way merges them; "partition" spills by hash range and
+    // groups the partitions in parallel; "hash" counts keys in a concurrent
+    // table; "auto" uses the table when sorted seeds would spill and the
+    // Bloom estimate of the table fits in --mem, and sorts otherwise.
+    // "topk" skips the Bloom filter and only seeds the top_k n-grams of a
+    // Space-Saving summary of document frequencies.
+    // seed_partitions = 0 sizes the partition count from --mem.
+    std::string seed_mode = "auto";
+    size_t seed_partitions = 0;
+    size_t top_k = 1000;
+
+    // Step 1.5 candidates move to an on-disk store in score order when they
+    // do not fit in --mem; this forces the on-disk store.
+    bool candidates_on_disk = false;
+
+    // Step 3 expands this many candidates concurrently before committing
+    // them in score order (0 = 32 per thread, 1 = serial).
+    size_t expansion_batch = 0;
+
+    // A Step 3 extension step over at least this many occurrences is split
+    // across all threads (0 = never).
+    size_t split_step_occs = 65536;
+
+    // Step 3 pops candidates from a max-heap and rescores them on their
+    // still-uncovered occurrences instead of following the Step 2 order.
+    bool rescore_candidates = false;
+
+    // Seed lengths of a cascade, longest first: each pass seeds only text
+    // that earlier passes left uncovered. Empty = one pass with `ngrams`.
+    std::vector<int> ngram_cascade = {};
+
+    // Fraction of documents sampled to choose the seed length when ngrams
+    // is 0: the smallest length whose projected seeds fit in --mem.
+    double auto_sample = 0.05;
 };
 
 // Abstract interface for all sequence mining algorithms
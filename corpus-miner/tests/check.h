@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../_ours/seed_record.h"
+
+// Minimal assertions for the unit tests under `make test`: a failed CHECK
+// is reported with its location and counted, and check_report() turns the
+// count into the test binary's exit status.
+inline int& check_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond)                                                                          \
+    do {                                                                                     \
+        if (!(cond)) {                                                                       \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #cond << std::endl; \
+            check_failures()++;                                                              \
+        }                                                                                    \
+    } while (0)
+
+inline int check_report(const char* name) {
+    if (check_failures() == 0) {
+        std::cout << "[TEST] " << name << ": OK" << std::endl;
+        return EXIT_SUCCESS;
+    }
+    std::cout << "[TEST] " << name << ": " << check_failures() << " check(s) failed" << std::endl;
+    return EXIT_FAILURE;
+}
+
+inline bool same_seeds(const std::vector<SeedRecord>& a, const std::vector<SeedRecord>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (a[i].hash != b[i].hash || a[i].doc_id != b[i].doc_id || a[i].pos != b[i].pos) return false;
+    return true;
+}
+
+// Fresh directory under the system temp dir, removed by the destructor.
+struct TempDir {
+    std::filesystem::path path;
+    explicit TempDir(const std::string& name) {
+        std::string tmpl = (std::filesystem::temp_directory_path() / (name + "_XXXXXX")).string();
+        if (!mkdtemp(tmpl.data())) {
+            std::cerr << "Could not create a temporary directory" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        path = tmpl;
+    }
+    ~TempDir() { std::filesystem::remove_all(path); }
+    std::string file(const std::string& name) const { return (path / name).string(); }
+};
@@ -0,0 +1,93 @@
+// End-to-end Step 3 invariant: every mined phrase is reported once, also on
+// text where many seeds sit inside one longer phrase and left-closure pulls
+// them onto a shared prefix.
+#include "check.h"
+#include "../corpus_miner.h"
+#include "../mining_algorithm.h"
+#include "../_ours/bloom_gram_miner.h"
+#include <algorithm>
+#include <fstream>
+#include <random>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Documents of random words with injected phrases, half of which share
+// their first half with another phrase.
+void write_corpus(const std::string& path) {
+    std::mt19937_64 rng(11);
+    auto word = [&](size_t range) { return "w" + std::to_string(rng() % range); };
+    std::vector<std::vector<std::string>> phrases;
+    for (int k = 0; k < 30; ++k) {
+        std::vector<std::string> p;
+        for (size_t j = 0, len = 4 + rng() % 12; j < len; ++j)
+            p.push_back(rng() % 10 < 7 ? "p" + std::to_string(k) + "_" + std::to_string(j) : word(50));
+        phrases.push_back(p);
+    }
+    for (int k = 0; k < 15; ++k) {
+        std::vector<std::string> p(phrases[k].begin(), phrases[k].begin() + phrases[k].size() / 2);
+        for (int j = 0; j < 5; ++j) p.push_back("v" + std::to_string(k) + "_" + std::to_string(j));
+        phrases.push_back(p);
+    }
+
+    std::ofstream out(path);
+    out << "text\n";
+    for (int d = 0; d < 1500; ++d) {
+        std::vector<std::string> words;
+        for (size_t i = 0, len = 50 + rng() % 200; i < len; ++i) words.push_back(word(rng() % 4 ? 3000 : 100));
+        for (size_t i = 0, inject = rng() % 4; i < inject; ++i) {
+            const auto& p = phrases[rng() % phrases.size()];
+            words.insert(words.begin() + rng() % (words.size() + 1), p.begin(), p.end());
+        }
+        for (size_t i = 0; i < words.size(); ++i) out << (i ? " " : "") << words[i];
+        out << "\n";
+    }
+}
+
+size_t repeated_phrases(std::vector<Phrase> phrases) {
+    std::sort(phrases.begin(), phrases.end(), [](const Phrase& a, const Phrase& b) { return a.tokens < b.tokens; });
+    size_t repeats = 0;
+    for (size_t i = 1; i < phrases.size(); ++i)
+        if (phrases[i].tokens == phrases[i - 1].tokens) repeats++;
+    return repeats;
+}
+
+} // namespace
+
+int main() {
+    TempDir dir("mining_test");
+    fs::current_path(dir.path); // the miner spills into ./miner_tmp
+    write_corpus(dir.file("corpus.csv"));
+
+    std::streambuf* log = std::cout.rdbuf(nullptr); // the miner logs to stdout
+    CorpusMiner corpus;
+    corpus.set_limits(4, 0, 1000, true, false, 3);
+    corpus.load_csv(dir.file("corpus.csv"));
+
+    struct Variant {
+        int ngrams, min_docs;
+        size_t expansion_batch;
+        bool rescore;
+    };
+    const Variant variants[] = {{3, 5, 0, false}, {4, 20, 0, false}, {4, 20, 1, false}, {3, 5, 0, true}};
+    std::vector<size_t> repeats, counts;
+    for (const Variant& v : variants) {
+        MiningParams params{v.min_docs, v.ngrams, "", v.ngrams};
+        params.expansion_batch = v.expansion_batch;
+        params.rescore_candidates = v.rescore;
+        std::vector<Phrase> phrases = BloomNgramMiner().mine(corpus, params);
+        counts.push_back(phrases.size());
+        repeats.push_back(repeated_phrases(std::move(phrases)));
+    }
+    std::cout.rdbuf(log);
+
+    for (size_t i = 0; i < repeats.size(); ++i) {
+        CHECK(counts[i] > 0);
+        CHECK(repeats[i] == 0);
+    }
+    // Batched and serial expansion commit the same phrases.
+    CHECK(counts[1] == counts[2]);
+    fs::current_path(dir.path.parent_path());
+    return check_report("mining");
+}
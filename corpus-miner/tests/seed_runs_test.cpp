@@ -0,0 +1,111 @@
+// Round trips of the spill run format, the fan-in cascade merge and the
+// hash-partitioned spill files, checked against std::sort.
+#include "check.h"
+#include "../_ours/seed_runs.h"
+#include <algorithm>
+#include <limits>
+#include <random>
+
+namespace {
+
+// Sorted seeds that exercise every delta case of the block format: repeated
+// hashes within and across documents, repeated (hash, doc) pairs, extreme
+// field values, and enough records to span several blocks.
+std::vector<SeedRecord> make_seeds(size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<SeedRecord> seeds;
+    seeds.reserve(n + 4);
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t hash = rng() % 4 == 0 ? rng() % 64 : rng();
+        seeds.push_back({hash, (uint32_t)(rng() % 1000), (uint32_t)(rng() % 5000)});
+    }
+    seeds.push_back({0, 0, 0});
+    seeds.push_back({std::numeric_limits<uint64_t>::max(), std::numeric_limits<uint32_t>::max(),
+                     std::numeric_limits<uint32_t>::max()});
+    seeds.push_back({std::numeric_limits<uint64_t>::max(), 0, std::numeric_limits<uint32_t>::max()});
+    seeds.push_back({1, std::numeric_limits<uint32_t>::max(), 0});
+    std::sort(seeds.begin(), seeds.end());
+    return seeds;
+}
+
+std::vector<SeedRecord> read_with(const std::string& path, size_t read_bytes) {
+    std::vector<SeedRecord> out;
+    SeedRunReader in(path, read_bytes);
+    while (!in.done()) {
+        out.push_back(in.current());
+        in.advance();
+    }
+    return out;
+}
+
+void test_round_trip(const TempDir& dir) {
+    for (size_t n : {(size_t)0, (size_t)1, SEED_RUN_BLOCK_RECORDS - 5, 3 * SEED_RUN_BLOCK_RECORDS + 17}) {
+        std::vector<SeedRecord> seeds = make_seeds(n, n + 1);
+        const std::string path = dir.file("run_" + std::to_string(n) + ".bin");
+
+        SeedRunWriter out(path);
+        for (const SeedRecord& r : seeds) out.append(r);
+        CHECK(out.close());
+        CHECK(out.records() == seeds.size());
+
+        std::vector<SeedRecord> back;
+        read_seed_run(path, back);
+        CHECK(same_seeds(back, seeds));
+        // A tiny read buffer splits block headers and payloads across refills.
+        CHECK(same_seeds(read_with(path, 4096), seeds));
+
+        CHECK(write_seed_run(path, seeds.data(), seeds.size()) == out.bytes());
+        CHECK(same_seeds(read_with(path, SeedRunReader::DEFAULT_READ_BYTES), seeds));
+    }
+}
+
+void test_cascade_merge(const TempDir& dir) {
+    std::vector<SeedRecord> all;
+    std::vector<std::string> runs;
+    for (size_t r = 0; r < 9; ++r) {
+        std::vector<SeedRecord> seeds = make_seeds(r == 4 ? 0 : 1000 * (r + 1), 100 + r);
+        runs.push_back(dir.file("spill_" + std::to_string(r) + ".bin"));
+        write_seed_run(runs.back(), seeds.data(), seeds.size());
+        all.insert(all.end(), seeds.begin(), seeds.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    SeedRunMerger merger(runs, dir.path.string(), 2);
+    CHECK(merger.fan_in() == 2);
+    CHECK(merger.passes() > 2);
+    std::vector<SeedRecord> merged;
+    for (; !merger.empty(); merger.pop()) merged.push_back(merger.top());
+    CHECK(same_seeds(merged, all));
+}
+
+void test_partitions(const TempDir& dir) {
+    std::vector<SeedRecord> seeds = make_seeds(50000, 7);
+    SeedPartitionWriter out(dir.path.string(), 16);
+    CHECK(out.partitions() == 16);
+    // Two sorted fragments, as two spilled buffers would write them.
+    const size_t half = seeds.size() / 2;
+    out.append(seeds.data(), half);
+    out.append(seeds.data() + half, seeds.size() - half);
+    CHECK(out.close());
+
+    std::vector<SeedRecord> all;
+    for (size_t p = 0; p < out.partitions(); ++p) {
+        std::vector<SeedRecord> part;
+        read_seed_run(out.path(p), part);
+        CHECK(part.size() == out.records(p));
+        for (const SeedRecord& r : part) CHECK(out.partition_of(r.hash) == p);
+        all.insert(all.end(), part.begin(), part.end());
+    }
+    std::sort(all.begin(), all.end());
+    CHECK(same_seeds(all, seeds));
+}
+
+} // namespace
+
+int main() {
+    TempDir dir("seed_runs_test");
+    test_round_trip(dir);
+    test_cascade_merge(dir);
+    test_partitions(dir);
+    return check_report("seed_runs");
+}
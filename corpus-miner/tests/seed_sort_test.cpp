@@ -0,0 +1,78 @@
+// Radix sorts of SeedRecord against std::sort on random and adversarial
+// inputs, around the cache-resident bucket size where the MSD split starts.
+#include "check.h"
+#include "../_ours/seed_sort.h"
+#include <algorithm>
+#include <functional>
+#include <omp.h>
+#include <random>
+
+namespace {
+
+// CACHE_RESIDENT in seed_sort.cpp: larger buckets are split on a hash byte.
+constexpr size_t CACHE_RESIDENT = 1u << 16;
+
+using Generator = std::function<SeedRecord(std::mt19937_64&, size_t)>;
+
+std::vector<SeedRecord> make_seeds(size_t n, const Generator& gen) {
+    std::mt19937_64 rng(n * 31 + 7);
+    std::vector<SeedRecord> seeds(n);
+    for (size_t i = 0; i < n; ++i) seeds[i] = gen(rng, i);
+    return seeds;
+}
+
+void check_sorts(const std::vector<SeedRecord>& input) {
+    std::vector<SeedRecord> expected = input;
+    std::sort(expected.begin(), expected.end());
+
+    std::vector<SeedRecord> serial = input, scratch;
+    radix_sort_seeds(serial.data(), serial.size(), scratch);
+    CHECK(same_seeds(serial, expected));
+
+    std::vector<SeedRecord> parallel = input;
+    parallel_radix_sort_seeds(parallel);
+    CHECK(same_seeds(parallel, expected));
+
+    // Nested inside a parallel region the team is smaller than
+    // omp_get_max_threads() asks for.
+    std::vector<SeedRecord> nested = input;
+    #pragma omp parallel num_threads(2)
+    {
+        #pragma omp single
+        parallel_radix_sort_seeds(nested);
+    }
+    CHECK(same_seeds(nested, expected));
+}
+
+} // namespace
+
+int main() {
+    omp_set_num_threads(4);
+    omp_set_max_active_levels(1);
+
+    const std::vector<std::pair<const char*, Generator>> inputs = {
+        {"random", [](std::mt19937_64& rng, size_t) {
+             return SeedRecord{rng(), (uint32_t)rng(), (uint32_t)rng()};
+         }},
+        {"equal top byte", [](std::mt19937_64& rng, size_t) {
+             return SeedRecord{(0xABULL << 56) | (rng() >> 8), (uint32_t)(rng() % 100), (uint32_t)rng()};
+         }},
+        {"few hashes", [](std::mt19937_64& rng, size_t) {
+             return SeedRecord{rng() % 3, (uint32_t)rng(), (uint32_t)(rng() % 1000)};
+         }},
+        {"one hash, doc-ordered", [](std::mt19937_64&, size_t i) {
+             return SeedRecord{42, (uint32_t)(i / 300), (uint32_t)(i % 300)};
+         }},
+        {"doc-ordered", [](std::mt19937_64& rng, size_t i) {
+             return SeedRecord{rng() % 5000 * 0x9E3779B97F4A7C15ULL, (uint32_t)(i / 300), (uint32_t)(i % 300)};
+         }},
+    };
+    const size_t sizes[] = {0, 1, 2, 255, 256, 1000, CACHE_RESIDENT - 1, CACHE_RESIDENT, CACHE_RESIDENT + 1,
+                            5 * CACHE_RESIDENT + 3};
+    for (const auto& [name, gen] : inputs) {
+        const int before = check_failures();
+        for (size_t n : sizes) check_sorts(make_seeds(n, gen));
+        if (check_failures() != before) std::cerr << "  input: " << name << std::endl;
+    }
+    return check_report("seed_sort");
+}
@@ -0,0 +1,67 @@
+// SeedHashTable under concurrent inserts: one slot per key, exact document
+// and occurrence counts, and FULL once the load limit is reached.
+#include "check.h"
+#include "../_ours/seed_table.h"
+#include <omp.h>
+#include <random>
+#include <unordered_map>
+
+namespace {
+
+void test_concurrent_counts() {
+    constexpr size_t KEYS = 20000;
+    constexpr size_t DOCS = 64;
+    std::mt19937_64 rng(5);
+    std::vector<uint64_t> keys(KEYS);
+    for (auto& k : keys) k = rng() | 2; // never 0 or 1, which share a slot
+
+    SeedHashTable table(KEYS);
+    std::vector<uint32_t> slot_of(KEYS, SeedHashTable::FULL);
+    // Every document offers every key with doc % 3 + 1 occurrences; threads
+    // race to claim the same slots.
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(4)
+    for (size_t d = 0; d < DOCS; ++d) {
+        for (size_t k = 0; k < KEYS; ++k) {
+            uint32_t slot = table.insert(keys[k]);
+            if (slot == SeedHashTable::FULL) continue;
+            table.add_doc(slot, (uint32_t)(d % 3 + 1));
+            if (d == 0) slot_of[k] = slot;
+        }
+    }
+
+    CHECK(table.used() == KEYS);
+    size_t expected_occurrences = 0;
+    for (size_t d = 0; d < DOCS; ++d) expected_occurrences += d % 3 + 1;
+    std::unordered_map<uint32_t, size_t> owners;
+    for (size_t k = 0; k < KEYS; ++k) {
+        const uint32_t slot = slot_of[k];
+        CHECK(slot != SeedHashTable::FULL);
+        if (slot == SeedHashTable::FULL) continue;
+        CHECK(table.insert(keys[k]) == slot);
+        CHECK(table.hash(slot) == keys[k]);
+        CHECK(table.docs(slot) == DOCS);
+        CHECK(table.occurrences(slot) == expected_occurrences);
+        CHECK(owners.emplace(slot, k).second);
+    }
+}
+
+void test_full() {
+    SeedHashTable table(10);
+    const size_t limit = table.capacity() / 4 * 3;
+    for (uint64_t k = 0; k < limit; ++k) CHECK(table.insert(1000 + k) != SeedHashTable::FULL);
+    CHECK(table.used() == limit);
+    CHECK(table.insert(999999) == SeedHashTable::FULL);
+    // Keys already in the table are still found.
+    CHECK(table.insert(1000) != SeedHashTable::FULL);
+    // Hash 0 is stored as key 1, since 0 marks empty slots.
+    SeedHashTable small(10);
+    CHECK(small.insert(0) == small.insert(1));
+}
+
+} // namespace
+
+int main() {
+    test_concurrent_counts();
+    test_full();
+    return check_report("seed_table");
+}
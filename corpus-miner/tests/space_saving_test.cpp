@@ -0,0 +1,83 @@
+// Space-Saving error bounds on a skewed stream, for one summary and for
+// per-thread summaries combined with merge().
+#include "check.h"
+#include "../_ours/space_saving.h"
+#include <cmath>
+#include <random>
+#include <unordered_map>
+
+namespace {
+
+// Zipf-like stream over 5000 keys: a few heavy hitters and a long tail.
+std::vector<uint64_t> make_stream(size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<double> weights(5000);
+    for (size_t i = 0; i < weights.size(); ++i) weights[i] = 1.0 / std::pow((double)(i + 1), 1.2);
+    std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+    std::vector<uint64_t> stream(n);
+    for (auto& k : stream) k = 0x9E3779B97F4A7C15ULL * (pick(rng) + 1);
+    return stream;
+}
+
+// The guarantees of space_saving.h against the exact counts.
+void check_bounds(const SpaceSavingSummary& s, const std::unordered_map<uint64_t, uint32_t>& exact) {
+    const double bound = (double)s.offered() / s.capacity();
+    std::unordered_map<uint64_t, SpaceSavingSummary::Entry> monitored;
+    for (const auto& e : s.top(s.capacity())) monitored[e.key] = e;
+    for (const auto& [key, e] : monitored) {
+        auto it = exact.find(key);
+        const uint32_t truth = it == exact.end() ? 0 : it->second;
+        CHECK(e.count - e.error <= truth);
+        CHECK(truth <= e.count);
+        CHECK(e.error <= bound);
+    }
+    for (const auto& [key, truth] : exact)
+        if (truth > bound) CHECK(monitored.count(key) == 1);
+}
+
+void test_single() {
+    std::vector<uint64_t> stream = make_stream(200000, 1);
+    std::unordered_map<uint64_t, uint32_t> exact;
+    SpaceSavingSummary s(200);
+    for (uint64_t k : stream) {
+        s.offer(k);
+        exact[k]++;
+    }
+    CHECK(s.offered() == stream.size());
+    CHECK(s.size() == s.capacity());
+    check_bounds(s, exact);
+}
+
+void test_merged() {
+    std::unordered_map<uint64_t, uint32_t> exact;
+    std::vector<SpaceSavingSummary> parts(4, SpaceSavingSummary(200));
+    for (size_t p = 0; p < parts.size(); ++p) {
+        for (uint64_t k : make_stream(50000, 10 + p)) {
+            parts[p].offer(k);
+            exact[k]++;
+        }
+    }
+    SpaceSavingSummary merged = parts[0];
+    for (size_t p = 1; p < parts.size(); ++p) merged.merge(parts[p]);
+    CHECK(merged.offered() == 200000);
+    CHECK(merged.size() <= merged.capacity());
+    check_bounds(merged, exact);
+
+    // A summary that never filled counts exactly.
+    SpaceSavingSummary small(100), other(100);
+    for (uint64_t k = 1; k <= 10; ++k)
+        for (uint64_t i = 0; i < k; ++i) (k % 2 ? small : other).offer(k);
+    small.merge(other);
+    auto top = small.top(3);
+    CHECK(top.size() == 3);
+    CHECK(top[0].key == 10 && top[0].count == 10 && top[0].error == 0);
+    CHECK(top[2].key == 8 && top[2].count == 8);
+}
+
+} // namespace
+
+int main() {
+    test_single();
+    test_merged();
+    return check_report("space_saving");
+}